@@ -28,6 +28,7 @@
 #include <time.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <sys/uio.h>
 #include "hard_disk.h"
 
 // parâmetros de operação do disco simulado
@@ -35,11 +36,29 @@
 #define DISK_BLOCK_SIZE  64		// tamanho de cada bloco, em bytes
 #define DISK_DELAY_MIN   30		// atraso minimo, em milisegundos
 #define DISK_DELAY_MAX  300		// atraso maximo, em milisegundos
+#define DISK_DELAY_XFER   2		// transferencia de cada bloco adicional (READV/WRITEV)
 
 //#define DEBUG_HD 1			// para depurar a operação do disco
 
 /**********************************************************************/
 
+// comando na fila interna do disco (NCQ); a posição na fila é a tag
+typedef struct {
+  int state ;			// CMD_FREE, CMD_QUEUED, CMD_ACTIVE ou CMD_DONE
+  int status ;			// DISK_STATUS_READ ou DISK_STATUS_WRITE
+  int block ;			// primeiro bloco do comando
+  int count ;			// blocos do comando (1 se nao vetorial)
+  int skipped ;			// vezes que outro comando passou na frente
+  struct iovec iov[DISK_IOV_MAX] ;	// buffers de cada bloco
+} harddisk_cmd_t ;
+
+#define CMD_FREE    0		// vaga livre
+#define CMD_QUEUED  1		// esperando a cabeca
+#define CMD_ACTIVE  2		// em execucao
+#define CMD_DONE    3		// concluido, esperando DISK_CMD_DONE
+
+#define CMD_MAX_SKIPS (4 * DISK_QUEUE_DEPTH)
+
 // estrutura com os dados internos do disco (estado inicial desconhecido)
 typedef struct {
   int status ;			// estado do disco
@@ -47,7 +66,11 @@ typedef struct {
   int fd ;			// descritor do arquivo que simula o disco
   int numblocks ;		// numero de blocos do disco
   int blocksize ;		// tamanho dos blocos em bytes
-  char *buffer ;		// buffer da proxima operacao (read/write)
+  harddisk_cmd_t queue[DISK_QUEUE_DEPTH] ;	// comandos aceitos
+  int active ;			// tag do comando em execucao (-1: nenhum)
+  int done[DISK_QUEUE_DEPTH] ;	// tags concluidas, em ordem de conclusao
+  int done_head, done_count ;
+  int count ;			// blocos da proxima operacao (1 se nao vetorial)
   int prev_block ;		// bloco da ultima operacao
   int next_block ;		// bloco da proxima operacao
   int delay_min, delay_max ;	// tempos de acesso mínimo e máximo
@@ -59,28 +82,75 @@ typedef struct {
 
 harddisk_t harddisk ;		// hard disk structure
 
+void harddisk_settimer () ;
+
 /**********************************************************************/
 
+// escolhe o proximo comando da fila interna pela menor distancia da cabeca,
+// como no NCQ; um comando preterido CMD_MAX_SKIPS vezes passa na frente
+void harddisk_start ()
+{
+  int tag, best = -1, dist, best_dist = 0 ;
+
+  for (tag = 0; tag < DISK_QUEUE_DEPTH; tag++)
+  {
+    if (harddisk.queue[tag].state != CMD_QUEUED)
+      continue ;
+    if (harddisk.queue[tag].skipped >= CMD_MAX_SKIPS)
+    {
+      best = tag ;
+      break ;
+    }
+    dist = abs (harddisk.queue[tag].block - harddisk.prev_block) ;
+    if (best < 0 || dist < best_dist)
+    {
+      best = tag ;
+      best_dist = dist ;
+    }
+  }
+
+  if (best < 0)
+    return ;
+
+  for (tag = 0; tag < DISK_QUEUE_DEPTH; tag++)
+    if (tag != best && harddisk.queue[tag].state == CMD_QUEUED)
+      harddisk.queue[tag].skipped++ ;
+
+  harddisk.active = best ;
+  harddisk.queue[best].state = CMD_ACTIVE ;
+  harddisk.status = harddisk.queue[best].status ;
+  harddisk.next_block = harddisk.queue[best].block ;
+  harddisk.count = harddisk.queue[best].count ;
+
+  // arma o timer que simula o atraso do disco
+  harddisk_settimer () ;
+}
+
 // trata o sinal SIGIO do timer que simula o tempo de acesso ao disco
 void harddisk_SignalHandle (int sig)
 {
+  harddisk_cmd_t *cmd ;
+
   #ifdef DEBUG_HD
   printf ("Harddisk: signal %d received\n", sig) ;
   #endif
 
+  if (harddisk.active < 0)
+    return ;
+  cmd = &harddisk.queue[harddisk.active] ;
+
   // verificar qual a operacao pendente e realiza-la
-  switch (harddisk.status)
+  lseek (harddisk.fd, cmd->block * harddisk.blocksize, SEEK_SET) ;
+  switch (cmd->status)
   {
     case DISK_STATUS_READ:
       // faz a leitura previamente agendada
-      lseek (harddisk.fd, harddisk.next_block * harddisk.blocksize, SEEK_SET) ;
-      read  (harddisk.fd, harddisk.buffer, harddisk.blocksize) ;
+      readv (harddisk.fd, cmd->iov, cmd->count) ;
       break ;
 
     case DISK_STATUS_WRITE:
       // faz a escrita previamente agendada
-      lseek (harddisk.fd, harddisk.next_block * harddisk.blocksize, SEEK_SET) ;
-      write (harddisk.fd, harddisk.buffer, harddisk.blocksize) ;
+      writev (harddisk.fd, cmd->iov, cmd->count) ;
       break ;
 
     default:
@@ -90,10 +160,17 @@ void harddisk_SignalHandle (int sig)
   }
 
   // guarda numero de bloco da ultima operacao
-  harddisk.prev_block = harddisk.next_block ;
+  harddisk.prev_block = cmd->block + cmd->count - 1 ;
+
+  // registra a conclusao, para DISK_CMD_DONE
+  cmd->state = CMD_DONE ;
+  harddisk.done[(harddisk.done_head + harddisk.done_count) % DISK_QUEUE_DEPTH] = harddisk.active ;
+  harddisk.done_count++ ;
 
-  // disco se torna ocioso novamente
+  // disco se torna ocioso, ou passa ao proximo comando da fila
+  harddisk.active = -1 ;
   harddisk.status = DISK_STATUS_IDLE ;
+  harddisk_start () ;
 
   // gerar um sinal SIGUSR1 para o "kernel" do usuario
   raise (SIGUSR1) ;
@@ -112,7 +189,8 @@ void harddisk_settimer ()
   time_ms = abs (harddisk.next_block - harddisk.prev_block)
           * (harddisk.delay_max - harddisk.delay_min) / harddisk.numblocks
           + harddisk.delay_min
-          + random () % (harddisk.delay_max - harddisk.delay_min) / 10 ;
+          + random () % (harddisk.delay_max - harddisk.delay_min) / 10
+          + (harddisk.count - 1) * DISK_DELAY_XFER ;
 
   // printf ("\n[%d->%d, %d]\n", harddisk.prev_block, harddisk.next_block, time_ms) ;
 
@@ -150,6 +228,8 @@ int harddisk_init ()
   // estado atual do disco
   harddisk.status = DISK_STATUS_IDLE ;
   harddisk.next_block = harddisk.prev_block = 0 ;
+  harddisk.active = -1 ;
+  harddisk.done_head = harddisk.done_count = 0 ;
 
   // abre o arquivo no disco (leitura/escrita, sincrono)
   harddisk.filename = DISK_NAME ;
@@ -233,28 +313,93 @@ int disk_cmd (int cmd, int block, void *buffer)
         return -1 ;
       return (harddisk.delay_max) ;
 
-    // solicita operação de leitura ou de escrita
+    // solicita tamanho da fila interna de comandos
+    case DISK_CMD_QDEPTH:
+      if ( harddisk.status == DISK_STATUS_UNKNOWN)
+        return -1 ;
+      return (DISK_QUEUE_DEPTH) ;
+
+    // retira a tag de um comando concluido
+    case DISK_CMD_DONE:
+    {
+      int tag = -1 ;
+      sigset_t sigio, old ;
+
+      sigemptyset (&sigio) ;
+      sigaddset (&sigio, SIGIO) ;
+      sigprocmask (SIG_BLOCK, &sigio, &old) ;
+      if (harddisk.done_count > 0)
+      {
+        tag = harddisk.done[harddisk.done_head] ;
+        harddisk.done_head = (harddisk.done_head + 1) % DISK_QUEUE_DEPTH ;
+        harddisk.done_count-- ;
+        harddisk.queue[tag].state = CMD_FREE ;
+      }
+      sigprocmask (SIG_SETMASK, &old, NULL) ;
+      return tag ;
+    }
+
+    // solicita operação de leitura ou de escrita, simples ou vetorial
     case DISK_CMD_READ:
     case DISK_CMD_WRITE:
-      if ( harddisk.status != DISK_STATUS_IDLE)
+    case DISK_CMD_READV:
+    case DISK_CMD_WRITEV:
+    {
+      disk_iovec_t *iov = buffer ;
+      int vector = (cmd == DISK_CMD_READV || cmd == DISK_CMD_WRITEV) ;
+      int count = vector && iov ? iov->count : 1 ;
+      int i, tag ;
+      harddisk_cmd_t *new ;
+      sigset_t sigio, old ;
+
+      if ( harddisk.status == DISK_STATUS_UNKNOWN)
         return -1 ;
-      if ( !buffer )
+      if ( !buffer || count < 1 || count > DISK_IOV_MAX )
         return -1 ;
-      if ( block < 0 || block >= harddisk.numblocks)
+      if ( block < 0 || block + count > harddisk.numblocks)
         return -1 ;
-
-      // registra que ha uma operacao pendente
-      harddisk.buffer = buffer ;
-      harddisk.next_block = block ;
-      if (cmd == DISK_CMD_READ)
-        harddisk.status = DISK_STATUS_READ ;
+      for (i = 0; vector && i < count; i++)
+        if ( !iov->buffers[i] )
+          return -1 ;
+
+      // o SIGIO nao pode mexer na fila interna enquanto ela muda
+      sigemptyset (&sigio) ;
+      sigaddset (&sigio, SIGIO) ;
+      sigprocmask (SIG_BLOCK, &sigio, &old) ;
+
+      for (tag = 0; tag < DISK_QUEUE_DEPTH; tag++)
+        if (harddisk.queue[tag].state == CMD_FREE)
+          break ;
+      if (tag == DISK_QUEUE_DEPTH)
+      {
+        // fila interna cheia
+        sigprocmask (SIG_SETMASK, &old, NULL) ;
+        return -1 ;
+      }
+
+      // registra o comando pendente
+      new = &harddisk.queue[tag] ;
+      new->block = block ;
+      new->count = count ;
+      new->skipped = 0 ;
+      for (i = 0; i < count; i++)
+      {
+        new->iov[i].iov_base = vector ? iov->buffers[i] : buffer ;
+        new->iov[i].iov_len  = harddisk.blocksize ;
+      }
+      if (cmd == DISK_CMD_READ || cmd == DISK_CMD_READV)
+        new->status = DISK_STATUS_READ ;
       else
-        harddisk.status = DISK_STATUS_WRITE ;
+        new->status = DISK_STATUS_WRITE ;
+      new->state = CMD_QUEUED ;
 
-      // arma o timer que simula o atraso do disco
-      harddisk_settimer () ;
+      // disco ocioso: comeca ja
+      if (harddisk.active < 0)
+        harddisk_start () ;
 
-      return 0 ;
+      sigprocmask (SIG_SETMASK, &old, NULL) ;
+      return tag ;
+    }
 
     default:
       return -1 ;
@@ -19,10 +19,25 @@
 #define DISK_CMD_BLOCKSIZE	5	// consulta tamanho de bloco em bytes
 #define DISK_CMD_DELAYMIN	6	// consulta tempo resposta mínimo (ms)
 #define DISK_CMD_DELAYMAX	7	// consulta tempo resposta máximo (ms)
+#define DISK_CMD_READV		8	// leitura de blocos consecutivos
+#define DISK_CMD_WRITEV		9	// escrita de blocos consecutivos
+#define DISK_CMD_QDEPTH		10	// consulta tamanho da fila de comandos
+#define DISK_CMD_DONE		11	// retira a tag de um comando concluido
+
+// comandos de leitura/escrita aceitos ao mesmo tempo (NCQ)
+#define DISK_QUEUE_DEPTH	8
+
+// blocos consecutivos de um comando READV/WRITEV, cada um com seu buffer
+#define DISK_IOV_MAX		32
+typedef struct
+{
+  int count ;				// número de blocos (1 a DISK_IOV_MAX)
+  void *buffers[DISK_IOV_MAX] ;		// buffer de cada bloco, em ordem
+} disk_iovec_t ;
 
 // estados internos do disco
 #define DISK_STATUS_UNKNOWN	0	// disco não inicializado
-#define DISK_STATUS_IDLE	1	// disco livre
+#define DISK_STATUS_IDLE	1	// disco sem comandos
 #define DISK_STATUS_READ	2	// disco ocupado fazendo leitura
 #define DISK_STATUS_WRITE	3	// disco ocupado fazendo escrita
 
@@ -30,6 +45,11 @@
 // operacao e retorna imediatamente. Quando a operacao solicitada for concluida,
 // o disco ira gerar um sinal SIGUSR1, que deve ser recebido e tratado pelo
 // gerenciador de discos, para acordar a tarefa que solicitou a operação.
+//
+// O disco aceita ate DISK_QUEUE_DEPTH leituras/escritas pendentes, cada uma
+// identificada pela tag devolvida ao agendar, e as executa na ordem de menor
+// distancia da cabeca. Sinais SIGUSR1 podem se acumular em um so': ao
+// recebe-lo, o gerenciador deve chamar DISK_CMD_DONE ate' obter -1.
 
 int disk_cmd (int cmd, int block, void *buffer) ;
 
@@ -42,20 +62,39 @@ int disk_cmd (int cmd, int block, void *buffer) ;
 //
 // agenda a leitura de um bloco de disco (operacao assincrona)
 // int disk_cmd (DISK_CMD_READ, int block, void *buffer) ;
-// result < 0: erro
-// result = 0: ok (leitura agendada, sinal SIGUSR1 serah gerado ao completar)
+// result <  0: erro (inclusive fila de comandos cheia)
+// result >= 0: ok, tag do comando (sinal SIGUSR1 serah gerado ao completar)
 //
 // agenda a escrita de um bloco de disco (operacao assincrona)
 // int disk_cmd (DISK_CMD_WRITE, int block, void *buffer) ;
-// result < 0: erro
-// result = 0: ok (escrita agendada, sinal SIGUSR1 serah gerado ao completar)
+// result <  0: erro (inclusive fila de comandos cheia)
+// result >= 0: ok, tag do comando (sinal SIGUSR1 serah gerado ao completar)
+//
+// agenda a leitura/escrita de iov->count blocos a partir de block, cada um
+// no seu buffer (operacao assincrona; o vetor e' copiado, os buffers devem
+// existir ate o sinal). A busca e' paga uma vez e cada bloco adicional custa
+// so' a transferencia.
+// int disk_cmd (DISK_CMD_READV, int block, disk_iovec_t *iov) ;
+// int disk_cmd (DISK_CMD_WRITEV, int block, disk_iovec_t *iov) ;
+// result <  0: erro (inclusive fila de comandos cheia)
+// result >= 0: ok, tag do comando (um unico sinal SIGUSR1 ao completar todos)
+//
+// retira um comando concluido (operacao sincrona)
+// int disk_cmd (DISK_CMD_DONE, 0, 0) ;
+// result <  0: nenhum comando concluido
+// result >= 0: tag do comando concluido (a tag fica livre para reuso)
+//
+// consulta tamanho da fila de comandos (operacao sincrona)
+// int disk_cmd (DISK_CMD_QDEPTH, 0, 0) ;
+// result <  0: erro
+// result >= 0: comandos de leitura/escrita aceitos ao mesmo tempo
 //
 // consulta status do disco (operacao sincrona)
 // int disk_cmd (DISK_CMD_STATUS, 0, 0) ;
 // result = 0: erro (disco não-inicializado ou inexistente)
-// result = 1: disco livre (disponível para comandos de leitura/escrita)
-// result = 2: disco ocupado realizando leitura (disco nao disponivel)
-// result = 3: disco ocupado realizando escrita (disco nao disponivel)
+// result = 1: disco sem comandos pendentes
+// result = 2: disco ocupado realizando leitura
+// result = 3: disco ocupado realizando escrita
 
 // consulta tamanho do disco (operacao sincrona)
 // int disk_cmd (DISK_CMD_DISKSIZE, 0, 0) ;
@@ -0,0 +1,92 @@
+// PingPongOS - PingPong Operating System
+
+// Teste de canais de difusão: um produtor publica NUMMSGS inteiros para três
+// assinantes, um deles lento. Com CHANNEL_BLOCK todos recebem tudo e o
+// produtor acompanha o mais lento; com CHANNEL_LAP o produtor não espera e o
+// assinante lento perde as mensagens mais antigas.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "ppos.h"
+
+#define NUMMSGS 200
+#define CHANLEN 8
+#define FIM     -1
+
+task_t prod, cons[3] ;
+subscriber_t sub[3] ;
+channel_t canal ;
+
+void prodBody (void * arg)
+{
+   int i, fim = FIM ;
+   unsigned int inicio = systime () ;
+
+   for (i=0; i<NUMMSGS; i++)
+   {
+      channel_publish (&canal, &i) ;
+      task_sleep (1) ;
+   }
+   channel_publish (&canal, &fim) ;
+   printf ("T%d publicou %d mensagens em %d ms\n", task_id(), NUMMSGS,
+           systime() - inicio) ;
+   task_exit (0) ;
+}
+
+void consBody (void * arg)
+{
+   subscriber_t *s = arg ;
+   int valor, recebidas = 0, soma = 0, ordem = 1, anterior = -1 ;
+   int lento = (s == &sub[2]) ;
+
+   while (channel_recv (s, &valor) == 0 && valor != FIM)
+   {
+      ordem = ordem && valor > anterior ;
+      anterior = valor ;
+      recebidas++ ;
+      soma += valor ;
+      if (lento)
+         task_sleep (5) ;
+   }
+   printf ("T%d%s recebeu %3d mensagens, perdeu %3d, %s\n", task_id(),
+           lento ? " (lento)" : "        ", recebidas, s->lost,
+           recebidas + s->lost == NUMMSGS && ordem ? "ok" : "ERRO") ;
+   task_exit (0) ;
+}
+
+void rodada (int policy)
+{
+   int i ;
+
+   printf ("%s:\n", policy == CHANNEL_BLOCK ? "CHANNEL_BLOCK" : "CHANNEL_LAP") ;
+   channel_create (&canal, CHANLEN, sizeof(int), policy) ;
+
+   // inscreve antes de publicar, para ninguém perder o início
+   for (i=0; i<3; i++)
+   {
+      channel_subscribe (&canal, &sub[i]) ;
+      task_create (&cons[i], consBody, &sub[i]) ;
+   }
+   task_create (&prod, prodBody, NULL) ;
+
+   task_join (&prod) ;
+   for (i=0; i<3; i++)
+      task_join (&cons[i]) ;
+
+   channel_destroy (&canal) ;
+}
+
+int main (int argc, char *argv[])
+{
+   printf ("main: inicio\n") ;
+
+   ppos_init () ;
+
+   rodada (CHANNEL_BLOCK) ;
+   rodada (CHANNEL_LAP) ;
+
+   printf ("main: fim\n") ;
+   task_exit (0) ;
+
+   exit (0) ;
+}
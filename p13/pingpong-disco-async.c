@@ -0,0 +1,126 @@
+// PingPongOS - PingPong Operating System
+
+// Teste da E/S assíncrona do disco: uma única tarefa lê NUMREADS blocos
+// aleatórios, primeiro um por vez com disk_block_read e depois em lotes de
+// LOTE pedidos com disk_submit_read e disk_wait_all. Com o lote inteiro na
+// fila o escalonador do disco escolhe a ordem, e a tarefa espera uma vez por
+// lote em vez de uma vez por bloco. Os dados lidos nas duas rodadas devem
+// ser iguais. Por fim, com o cache ligado, uma escrita assíncrona seguida de
+// uma leitura do mesmo bloco, com o disco ocupado, não pode deixar o
+// conteúdo antigo no cache.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ppos.h"
+#include "ppos_disk.h"
+
+#define NUMREADS 64
+#define LOTE     8
+#define CACHESIZE 16
+
+task_t leitor ;
+int blocos[NUMREADS] ;
+char *dados[2][NUMREADS] ;
+int numBlocks, blockSize ;
+int erros ;
+
+// escreve blocos[0] de forma assíncrona e o lê enquanto a escrita espera na
+// fila do disco; depois o cache deve ter o conteúdo novo
+void coerencia ()
+{
+   disk_request_t *ocupa, *escrita ;
+   char *novo = malloc (blockSize) ;
+   char *lido = malloc (blockSize) ;
+   char *outro = malloc (blockSize) ;
+
+   disk_cache_config (CACHESIZE) ;
+   memset (novo, 0x5a, blockSize) ;
+
+   ocupa = disk_submit_read ((blocos[0] + numBlocks / 2) % numBlocks, outro) ;
+   escrita = disk_submit_write (blocos[0], novo) ;
+   disk_block_read (blocos[0], lido) ;
+   if (disk_wait (escrita) < 0 || disk_wait (ocupa) < 0)
+      erros++ ;
+   if (memcmp (lido, novo, blockSize))
+      erros++ ;
+
+   disk_block_read (blocos[0], lido) ;
+   if (memcmp (lido, novo, blockSize))
+   {
+      printf ("cache: a leitura depois da escrita assíncrona veio antiga\n") ;
+      erros++ ;
+   }
+
+   // devolve o bloco ao disco como estava
+   disk_block_write (blocos[0], dados[0][0]) ;
+   disk_cache_config (0) ;
+
+   free (novo) ;
+   free (lido) ;
+   free (outro) ;
+}
+
+void leitorBody (void * arg)
+{
+   disk_request_t *pedidos[LOTE] ;
+   unsigned int inicio ;
+   int i, j ;
+
+   inicio = systime () ;
+   for (i=0; i<NUMREADS; i++)
+      if (disk_block_read (blocos[i], dados[0][i]) < 0)
+         erros++ ;
+   printf ("serial:     %d leituras em %5d ms\n", NUMREADS, systime() - inicio) ;
+
+   inicio = systime () ;
+   for (i=0; i<NUMREADS; i+=LOTE)
+   {
+      for (j=0; j<LOTE; j++)
+         pedidos[j] = disk_submit_read (blocos[i+j], dados[1][i+j]) ;
+      if (disk_wait_all (pedidos, LOTE) < 0)
+         erros++ ;
+   }
+   printf ("assíncrono: %d leituras em %5d ms (lotes de %d)\n", NUMREADS,
+           systime() - inicio, LOTE) ;
+
+   for (i=0; i<NUMREADS; i++)
+      if (memcmp (dados[0][i], dados[1][i], blockSize))
+         erros++ ;
+   coerencia () ;
+
+   printf ("%d erros\n", erros) ;
+
+   task_exit (0) ;
+}
+
+int main (int argc, char *argv[])
+{
+   int i ;
+
+   printf ("main: inicio\n") ;
+
+   ppos_init () ;
+
+   if (disk_mgr_init (&numBlocks, &blockSize) < 0)
+   {
+      printf ("Erro na abertura do disco\n") ;
+      exit (1) ;
+   }
+
+   srandom (42) ;
+   for (i=0; i<NUMREADS; i++)
+   {
+      blocos[i] = random () % numBlocks ;
+      dados[0][i] = malloc (blockSize) ;
+      dados[1][i] = malloc (blockSize) ;
+   }
+
+   task_create (&leitor, leitorBody, NULL) ;
+   task_join (&leitor) ;
+
+   printf ("main: fim\n") ;
+   task_exit (0) ;
+
+   exit (0) ;
+}
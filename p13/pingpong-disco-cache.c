@@ -0,0 +1,86 @@
+// PingPongOS - PingPong Operating System
+
+// Teste do cache de blocos: NUMTASKS tarefas acessam o disco com localidade
+// (a maioria dos acessos cai em HOTBLOCKS blocos) e regravam alguns blocos
+// com o próprio conteúdo, sem e com cache. No fim o cache é gravado com
+// disk_sync e o disco termina como começou.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "ppos.h"
+#include "ppos_disk.h"
+
+#define NUMTASKS   16
+#define NUMACCESS  32
+#define HOTBLOCKS  16
+#define CACHESIZE  32
+
+task_t tarefa[NUMTASKS] ;
+int numBlocks, blockSize ;
+int erros ;
+
+void tarefaBody (void * arg)
+{
+   char *buffer = malloc (blockSize) ;
+   int i, block ;
+
+   for (i=0; i<NUMACCESS; i++)
+   {
+      block = (random () % 10 < 8) ? random () % HOTBLOCKS
+                                   : random () % numBlocks ;
+      if (disk_block_read (block, buffer) < 0)
+         erros++ ;
+      if (i % 4 == 0 && disk_block_write (block, buffer) < 0)
+         erros++ ;
+   }
+   free (buffer) ;
+   task_exit (0) ;
+}
+
+void rodada (int cache)
+{
+   long i ;
+   unsigned int inicio ;
+
+   disk_cache_config (cache) ;
+   disk_set_scheduler (DISK_SSTF) ;
+   srandom (11) ;
+   inicio = systime () ;
+
+   for (i=0; i<NUMTASKS; i++)
+      task_create (&tarefa[i], tarefaBody, NULL) ;
+   for (i=0; i<NUMTASKS; i++)
+      task_join (&tarefa[i]) ;
+
+   printf ("cache de %2d blocos: %d acessos em %5d ms, %d erros\n", cache,
+           NUMTASKS * NUMACCESS * 5 / 4, systime() - inicio, erros) ;
+   disk_print_stats () ;
+
+   if (cache)
+   {
+      disk_sync () ;
+      printf ("após disk_sync:\n") ;
+      disk_print_stats () ;
+   }
+}
+
+int main (int argc, char *argv[])
+{
+   printf ("main: inicio\n") ;
+
+   ppos_init () ;
+
+   if (disk_mgr_init (&numBlocks, &blockSize) < 0)
+   {
+      printf ("Erro na abertura do disco\n") ;
+      exit (1) ;
+   }
+
+   rodada (0) ;
+   rodada (CACHESIZE) ;
+
+   printf ("main: fim\n") ;
+   task_exit (0) ;
+
+   exit (0) ;
+}
@@ -0,0 +1,99 @@
+// PingPongOS - PingPong Operating System
+
+// Teste da política DISK_DEADLINE: leitores sensíveis à latência disputam o
+// disco com escritores em massa. Os escritores regravam o conteúdo original
+// dos seus blocos, então o disco termina como começou.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "ppos.h"
+#include "ppos_disk.h"
+
+#define NUMREADERS 4
+#define NUMWRITERS 12
+#define NUMREADS   16
+#define NUMWRITES  8
+
+task_t leitor[NUMREADERS], escritor[NUMWRITERS] ;
+int numBlocks, blockSize ;
+int erros ;
+unsigned int soma, pior ;	// latência das leituras dos leitores
+
+void leitorBody (void * arg)
+{
+   char *buffer = malloc (blockSize) ;
+   int i ;
+   unsigned int inicio, latencia ;
+
+   for (i=0; i<NUMREADS; i++)
+   {
+      inicio = systime () ;
+      if (disk_block_read (random () % numBlocks, buffer) < 0)
+         erros++ ;
+      latencia = systime () - inicio ;
+      soma += latencia ;
+      pior = latencia > pior ? latencia : pior ;
+      task_sleep (20) ;		// processa o bloco lido
+   }
+   free (buffer) ;
+   task_exit (0) ;
+}
+
+void escritorBody (void * arg)
+{
+   char *buffer = malloc (blockSize) ;
+   int i, base = (long) arg * (numBlocks / NUMWRITERS) ;
+
+   for (i=0; i<NUMWRITES; i++)
+   {
+      if (disk_block_read (base + i, buffer) < 0 ||
+          disk_block_write (base + i, buffer) < 0)
+         erros++ ;
+   }
+   free (buffer) ;
+   task_exit (0) ;
+}
+
+void rodada (int policy)
+{
+   long i ;
+
+   disk_set_scheduler (policy) ;
+   srandom (7) ;
+   soma = pior = 0 ;
+
+   for (i=0; i<NUMWRITERS; i++)
+      task_create (&escritor[i], escritorBody, (void *) i) ;
+   for (i=0; i<NUMREADERS; i++)
+      task_create (&leitor[i], leitorBody, NULL) ;
+
+   for (i=0; i<NUMREADERS; i++)
+      task_join (&leitor[i]) ;
+   for (i=0; i<NUMWRITERS; i++)
+      task_join (&escritor[i]) ;
+
+   disk_print_stats () ;
+   printf ("  leitores: latência média %4d ms, pior %4d ms\n",
+           soma / (NUMREADERS * NUMREADS), pior) ;
+}
+
+int main (int argc, char *argv[])
+{
+   printf ("main: inicio\n") ;
+
+   ppos_init () ;
+
+   if (disk_mgr_init (&numBlocks, &blockSize) < 0)
+   {
+      printf ("Erro na abertura do disco\n") ;
+      exit (1) ;
+   }
+
+   rodada (DISK_SSTF) ;
+   rodada (DISK_DEADLINE) ;
+
+   printf ("main: fim, %d erros\n", erros) ;
+   task_exit (0) ;
+
+   exit (0) ;
+}
@@ -0,0 +1,77 @@
+// PingPongOS - PingPong Operating System
+
+// Teste da junção de pedidos vizinhos: NUMTASKS tarefas copiam cada uma
+// NUMBLOCKS blocos, lendo e regravando o próprio conteúdo (o disco termina
+// como começou). Na rodada intercalada as tarefas pedem ao mesmo tempo blocos
+// consecutivos, que o gerente junta em comandos READV/WRITEV; na espaçada os
+// pedidos simultâneos ficam a NUMBLOCKS blocos uns dos outros.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "ppos.h"
+#include "ppos_disk.h"
+
+#define NUMTASKS  16
+#define NUMBLOCKS 8
+
+task_t tarefa[NUMTASKS] ;
+int numBlocks, blockSize ;
+int intercalado ;
+int erros ;
+
+void tarefaBody (void * arg)
+{
+   char *buffer = malloc (blockSize) ;
+   int i, block, id = (long) arg ;
+
+   for (i=0; i<NUMBLOCKS; i++)
+   {
+      block = intercalado ? i * NUMTASKS + id : id * NUMBLOCKS + i ;
+      if (disk_block_read (block, buffer) < 0 ||
+          disk_block_write (block, buffer) < 0)
+         erros++ ;
+   }
+   free (buffer) ;
+   task_exit (0) ;
+}
+
+void rodada (int modo)
+{
+   long i ;
+   unsigned int inicio ;
+
+   intercalado = modo ;
+   disk_set_scheduler (DISK_SSTF) ;
+   inicio = systime () ;
+
+   for (i=0; i<NUMTASKS; i++)
+      task_create (&tarefa[i], tarefaBody, (void *) i) ;
+   for (i=0; i<NUMTASKS; i++)
+      task_join (&tarefa[i]) ;
+
+   printf ("%s: %d blocos copiados em %5d ms, %d erros\n",
+           intercalado ? "intercalado" : "espaçado   ", NUMTASKS * NUMBLOCKS,
+           systime() - inicio, erros) ;
+   disk_print_stats () ;
+}
+
+int main (int argc, char *argv[])
+{
+   printf ("main: inicio\n") ;
+
+   ppos_init () ;
+
+   if (disk_mgr_init (&numBlocks, &blockSize) < 0)
+   {
+      printf ("Erro na abertura do disco\n") ;
+      exit (1) ;
+   }
+
+   rodada (0) ;
+   rodada (1) ;
+
+   printf ("main: fim\n") ;
+   task_exit (0) ;
+
+   exit (0) ;
+}
@@ -0,0 +1,75 @@
+// PingPongOS - PingPong Operating System
+
+// Teste da leitura antecipada: NUMTASKS tarefas percorrem, cada uma, uma
+// faixa de NUMREADS blocos consecutivos em regiões distantes do disco,
+// processando cada bloco lido. Sem leitura antecipada a cabeça alterna
+// entre as faixas a cada pedido.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "ppos.h"
+#include "ppos_disk.h"
+
+#define NUMTASKS  2
+#define NUMREADS  48
+#define CACHESIZE 64
+
+task_t tarefa[NUMTASKS] ;
+int numBlocks, blockSize ;
+int erros ;
+
+void tarefaBody (void * arg)
+{
+   char *buffer = malloc (blockSize) ;
+   int i, base = (long) arg * (numBlocks / NUMTASKS) ;
+
+   for (i=0; i<NUMREADS; i++)
+   {
+      if (disk_block_read (base + i, buffer) < 0)
+         erros++ ;
+      task_sleep (10) ;		// processa o bloco
+   }
+   free (buffer) ;
+   task_exit (0) ;
+}
+
+void rodada (int janela)
+{
+   long i ;
+   unsigned int inicio ;
+
+   disk_cache_config (CACHESIZE) ;	// começa com o cache vazio
+   disk_set_readahead (janela) ;
+   disk_set_scheduler (DISK_SSTF) ;
+   inicio = systime () ;
+
+   for (i=0; i<NUMTASKS; i++)
+      task_create (&tarefa[i], tarefaBody, (void *) i) ;
+   for (i=0; i<NUMTASKS; i++)
+      task_join (&tarefa[i]) ;
+
+   printf ("janela máxima %2d: %d blocos em %5d ms, %d erros\n", janela,
+           NUMTASKS * NUMREADS, systime() - inicio, erros) ;
+   disk_print_stats () ;
+}
+
+int main (int argc, char *argv[])
+{
+   printf ("main: inicio\n") ;
+
+   ppos_init () ;
+
+   if (disk_mgr_init (&numBlocks, &blockSize) < 0)
+   {
+      printf ("Erro na abertura do disco\n") ;
+      exit (1) ;
+   }
+
+   rodada (0) ;
+   rodada (DISK_RA_MAX) ;
+
+   printf ("main: fim\n") ;
+   task_exit (0) ;
+
+   exit (0) ;
+}
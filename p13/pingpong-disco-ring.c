@@ -0,0 +1,166 @@
+// PingPongOS - PingPong Operating System
+
+// Teste dos anéis de submissão e conclusão do disco: uma tarefa lê NUMREADS
+// blocos aleatórios com disk_submit_read/disk_wait_all em lotes de LOTE, e
+// depois pelo anel, mantendo até EMVOO pedidos no disco e colhendo as
+// conclusões em bloco. Por fim regrava pelo anel os blocos lidos, o que deixa
+// o disco inalterado. Os dados lidos nas duas formas devem ser iguais. Com o
+// cache ligado, uma escrita pelo anel seguida de uma leitura do mesmo bloco,
+// com o disco ocupado, não pode deixar o conteúdo antigo no cache.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ppos.h"
+#include "ppos_disk.h"
+
+#define NUMREADS 64
+#define LOTE     8
+#define EMVOO    16
+#define CACHESIZE 16
+
+task_t leitor ;
+disk_ring_t anel ;
+int blocos[NUMREADS] ;
+char *dados[2][NUMREADS] ;
+int numBlocks, blockSize ;
+int erros ;
+
+// envia os NUMREADS pedidos pelo anel com até EMVOO no disco
+void pelo_anel (int type, char **buffers)
+{
+   disk_cqe_t cqes[EMVOO] ;
+   int enviados = 0, concluidos = 0, emvoo = 0, i, n ;
+
+   while (concluidos < NUMREADS)
+   {
+      while (enviados < NUMREADS && emvoo < EMVOO)
+      {
+         disk_ring_prep (&anel, type, blocos[enviados], buffers[enviados], NULL) ;
+         enviados++ ;
+         emvoo++ ;
+      }
+      disk_ring_submit (&anel) ;
+
+      n = disk_ring_reap (&anel, cqes, EMVOO, 1) ;
+      for (i=0; i<n; i++)
+         if (cqes[i].result < 0)
+            erros++ ;
+      concluidos += n ;
+      emvoo -= n ;
+   }
+}
+
+// escreve blocos[0] pelo anel e o lê enquanto a escrita espera na fila do
+// disco; depois o cache deve ter o conteúdo novo
+void coerencia ()
+{
+   disk_cqe_t cqes[2] ;
+   char *novo = malloc (blockSize) ;
+   char *lido = malloc (blockSize) ;
+   char *outro = malloc (blockSize) ;
+   int i, n = 0 ;
+
+   disk_cache_config (CACHESIZE) ;
+   memset (novo, 0x5a, blockSize) ;
+
+   disk_ring_prep (&anel, DISK_READ, (blocos[0] + numBlocks / 2) % numBlocks, outro, NULL) ;
+   disk_ring_prep (&anel, DISK_WRITE, blocos[0], novo, NULL) ;
+   disk_ring_submit (&anel) ;
+   task_sleep (1) ;		// o gerente retira as entradas do anel
+   disk_block_read (blocos[0], lido) ;
+   while (n < 2)
+   {
+      int m = disk_ring_reap (&anel, cqes, 2 - n, 1) ;
+      for (i=0; i<m; i++)
+         if (cqes[i].result < 0)
+            erros++ ;
+      n += m ;
+   }
+
+   disk_block_read (blocos[0], lido) ;
+   if (memcmp (lido, novo, blockSize))
+   {
+      printf ("cache: a leitura depois da escrita pelo anel veio antiga\n") ;
+      erros++ ;
+   }
+
+   // devolve o bloco ao disco como estava
+   disk_block_write (blocos[0], dados[0][0]) ;
+   disk_cache_config (0) ;
+
+   free (novo) ;
+   free (lido) ;
+   free (outro) ;
+}
+
+void leitorBody (void * arg)
+{
+   disk_request_t *pedidos[LOTE] ;
+   unsigned int inicio ;
+   int i, j ;
+
+   inicio = systime () ;
+   for (i=0; i<NUMREADS; i+=LOTE)
+   {
+      for (j=0; j<LOTE; j++)
+         pedidos[j] = disk_submit_read (blocos[i+j], dados[0][i+j]) ;
+      if (disk_wait_all (pedidos, LOTE) < 0)
+         erros++ ;
+   }
+   printf ("lotes: %d leituras em %5d ms (lotes de %d)\n", NUMREADS,
+           systime() - inicio, LOTE) ;
+
+   disk_ring_init (&anel) ;
+
+   inicio = systime () ;
+   pelo_anel (DISK_READ, dados[1]) ;
+   printf ("anel:  %d leituras em %5d ms (até %d no disco)\n", NUMREADS,
+           systime() - inicio, EMVOO) ;
+
+   for (i=0; i<NUMREADS; i++)
+      if (memcmp (dados[0][i], dados[1][i], blockSize))
+         erros++ ;
+
+   inicio = systime () ;
+   pelo_anel (DISK_WRITE, dados[1]) ;
+   printf ("anel:  %d escritas em %5d ms\n", NUMREADS, systime() - inicio) ;
+
+   coerencia () ;
+
+   disk_ring_destroy (&anel) ;
+   printf ("%d erros\n", erros) ;
+
+   task_exit (0) ;
+}
+
+int main (int argc, char *argv[])
+{
+   int i ;
+
+   printf ("main: inicio\n") ;
+
+   ppos_init () ;
+
+   if (disk_mgr_init (&numBlocks, &blockSize) < 0)
+   {
+      printf ("Erro na abertura do disco\n") ;
+      exit (1) ;
+   }
+
+   srandom (42) ;
+   for (i=0; i<NUMREADS; i++)
+   {
+      blocos[i] = random () % numBlocks ;
+      dados[0][i] = malloc (blockSize) ;
+      dados[1][i] = malloc (blockSize) ;
+   }
+
+   task_create (&leitor, leitorBody, NULL) ;
+   task_join (&leitor) ;
+
+   printf ("main: fim\n") ;
+   task_exit (0) ;
+
+   exit (0) ;
+}
@@ -0,0 +1,79 @@
+// PingPongOS - PingPong Operating System
+
+// Teste das políticas de escalonamento do disco: NUMTASKS tarefas leem
+// blocos aleatórios (os mesmos em todas as rodadas) e cada rodada mostra o
+// tempo total, o percurso da cabeça e a latência média dos pedidos.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "ppos.h"
+#include "ppos_disk.h"
+
+#define NUMTASKS 16
+#define NUMREADS 8
+
+task_t leitor[NUMTASKS] ;
+int blocos[NUMTASKS][NUMREADS] ;
+int numBlocks, blockSize ;
+int erros ;
+
+void leitorBody (void * arg)
+{
+   long id = (long) arg ;
+   char *buffer = malloc (blockSize) ;
+   int i ;
+
+   for (i=0; i<NUMREADS; i++)
+      if (disk_block_read (blocos[id][i], buffer) < 0)
+         erros++ ;
+
+   free (buffer) ;
+   task_exit (0) ;
+}
+
+void rodada (int policy)
+{
+   long i ;
+   unsigned int inicio ;
+
+   disk_set_scheduler (policy) ;
+   inicio = systime () ;
+
+   for (i=0; i<NUMTASKS; i++)
+      task_create (&leitor[i], leitorBody, (void *) i) ;
+   for (i=0; i<NUMTASKS; i++)
+      task_join (&leitor[i]) ;
+
+   printf ("%d leituras em %5d ms, %d erros\n", NUMTASKS * NUMREADS,
+           systime() - inicio, erros) ;
+   disk_print_stats () ;
+}
+
+int main (int argc, char *argv[])
+{
+   int i, j ;
+
+   printf ("main: inicio\n") ;
+
+   ppos_init () ;
+
+   if (disk_mgr_init (&numBlocks, &blockSize) < 0)
+   {
+      printf ("Erro na abertura do disco\n") ;
+      exit (1) ;
+   }
+
+   srandom (42) ;
+   for (i=0; i<NUMTASKS; i++)
+      for (j=0; j<NUMREADS; j++)
+         blocos[i][j] = random () % numBlocks ;
+
+   rodada (DISK_FCFS) ;
+   rodada (DISK_SSTF) ;
+   rodada (DISK_CSCAN) ;
+
+   printf ("main: fim\n") ;
+   task_exit (0) ;
+
+   exit (0) ;
+}
@@ -0,0 +1,105 @@
+// PingPongOS - PingPong Operating System
+
+// Teste das leituras de disco com prazo e não-bloqueantes: sem e com cache,
+// disk_block_read_try só atende blocos do cache, e disk_block_read_timed com
+// prazo menor que o acesso ao disco desiste sem que o disco escreva depois
+// no buffer de quem pediu. Com o cache, a leitura abandonada termina no cache
+// e um _try seguinte a encontra lá.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ppos.h"
+#include "ppos_disk.h"
+
+#define CURTO    5	// ms, menos que o acesso mais rápido do disco
+#define LONGO 1000	// ms, mais que o acesso mais lento
+
+task_t leitor ;
+int numBlocks, blockSize ;
+int erros ;
+
+void confere (char *fase, char *op, int obtido, int esperado)
+{
+   printf ("%s: %-14s retornou %2d (esperado %2d)\n", fase, op, obtido, esperado) ;
+   if (obtido != esperado)
+      erros++ ;
+}
+
+// lê o bloco com prazo curto e verifica que o buffer não muda depois
+void desiste (char *fase, int block)
+{
+   char *buffer = malloc (blockSize) ;
+   int i, alterado = 0 ;
+
+   memset (buffer, 0x55, blockSize) ;
+   confere (fase, "timed curto", disk_block_read_timed (block, buffer, CURTO), PPOS_ETIMEDOUT) ;
+   task_sleep (LONGO) ;		// a leitura abandonada termina aqui
+   for (i=0; i<blockSize; i++)
+      if (buffer[i] != 0x55)
+         alterado = 1 ;
+   if (alterado)
+   {
+      printf ("%s: o disco escreveu no buffer depois do prazo\n", fase) ;
+      erros++ ;
+   }
+   free (buffer) ;
+}
+
+void leitorBody (void * arg)
+{
+   char *ref[2], *buffer ;
+   int blocos[2], i ;
+
+   buffer = malloc (blockSize) ;
+   blocos[0] = numBlocks / 4 ;
+   blocos[1] = 3 * numBlocks / 4 ;
+   for (i=0; i<2; i++)
+   {
+      ref[i] = malloc (blockSize) ;
+      if (disk_block_read (blocos[i], ref[i]) < 0)
+         erros++ ;
+   }
+
+   // sem cache, _try nunca atende
+   confere ("sem cache", "try", disk_block_read_try (blocos[0], buffer), PPOS_EAGAIN) ;
+   desiste ("sem cache", blocos[0]) ;
+   confere ("sem cache", "timed longo", disk_block_read_timed (blocos[0], buffer, LONGO), 0) ;
+   if (memcmp (buffer, ref[0], blockSize))
+      erros++ ;
+
+   disk_cache_config (8) ;
+   confere ("com cache", "try", disk_block_read_try (blocos[1], buffer), PPOS_EAGAIN) ;
+   desiste ("com cache", blocos[1]) ;
+   confere ("com cache", "try depois", disk_block_read_try (blocos[1], buffer), 0) ;
+   if (memcmp (buffer, ref[1], blockSize))
+      erros++ ;
+   confere ("com cache", "timed longo", disk_block_read_timed (blocos[0], buffer, LONGO), 0) ;
+   if (memcmp (buffer, ref[0], blockSize))
+      erros++ ;
+   disk_cache_config (0) ;
+
+   printf ("%d erros\n", erros) ;
+   task_exit (0) ;
+}
+
+int main (int argc, char *argv[])
+{
+   printf ("main: inicio\n") ;
+
+   ppos_init () ;
+
+   if (disk_mgr_init (&numBlocks, &blockSize) < 0)
+   {
+      printf ("Erro na abertura do disco\n") ;
+      exit (1) ;
+   }
+
+   task_create (&leitor, leitorBody, NULL) ;
+   task_join (&leitor) ;
+
+   printf ("main: fim\n") ;
+   task_exit (0) ;
+
+   exit (0) ;
+}
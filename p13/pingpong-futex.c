@@ -0,0 +1,84 @@
+// PingPongOS - PingPong Operating System
+
+// Teste de espera em endereço (ppos_wait/ppos_wake): mutex construído
+// diretamente sobre a tabela de espera do núcleo, sem semáforos
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "ppos.h"
+
+#define NUMTASKS 30
+#define NUMSTEPS 100000
+
+task_t task[NUMTASKS] ;
+int lock = 0 ;			// 0: livre, 1: ocupado, 2: ocupado com espera
+long int soma = 0 ;
+
+void lock_acquire ()
+{
+   int c = __sync_val_compare_and_swap (&lock, 0, 1) ;
+
+   if (c == 0)
+      return ;
+
+   // marca que há tarefas esperando e dorme enquanto continuar ocupado
+   if (c != 2)
+      c = __sync_lock_test_and_set (&lock, 2) ;
+   while (c != 0)
+   {
+      ppos_wait (&lock, 2) ;
+      c = __sync_lock_test_and_set (&lock, 2) ;
+   }
+}
+
+void lock_release ()
+{
+   if (__sync_fetch_and_sub (&lock, 1) != 1)
+   {
+      lock = 0 ;
+      ppos_wake (&lock, 1) ;
+   }
+}
+
+// corpo das threads
+void taskBody(void *id)
+{
+   int i ;
+
+   for (i=0; i< NUMSTEPS; i++)
+   {
+      lock_acquire () ;
+      soma += 1 ;
+      lock_release () ;
+   }
+
+   task_exit (0) ;
+}
+
+int main (int argc, char *argv[])
+{
+   int i ;
+
+   printf ("main: inicio\n") ;
+
+   ppos_init () ;
+
+   printf ("%d tarefas somando %d vezes cada, aguarde...\n",
+           NUMTASKS, NUMSTEPS) ;
+
+   for (i=0; i<NUMTASKS; i++)
+     task_create (&task[i], taskBody, "Task") ;
+
+   for (i=0; i<NUMTASKS; i++)
+     task_join (&task[i]) ;
+
+   if (soma == (NUMTASKS*NUMSTEPS))
+     printf ("Soma deu %ld, valor correto!\n", soma) ;
+   else
+     printf ("Soma deu %ld, mas deveria ser %d!\n",
+             soma, NUMTASKS*NUMSTEPS) ;
+
+   task_exit (0) ;
+
+   exit (0) ;
+}
@@ -0,0 +1,79 @@
+// PingPongOS - PingPong Operating System
+
+// Mede trocas de contexto por operação no semáforo, com e sem handoff
+// direto em sem_up (mesma carga do teste pingpong-racecond)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "ppos.h"
+
+#define NUMTASKS 30
+#define NUMSTEPS 200000
+
+task_t task[NUMTASKS] ;
+semaphore_t  s ;
+long int soma = 0 ;
+
+// corpo das threads
+void taskBody(void *id)
+{
+   int i ;
+
+   for (i=0; i< NUMSTEPS; i++)
+   {
+      sem_down (&s) ;
+      soma += 1 ;
+      sem_up (&s) ;
+   }
+
+   task_exit (0) ;
+}
+
+// roda a carga com as opções indicadas e mostra as trocas por operação
+void rodada (char *nome, int flags)
+{
+   int i ;
+   unsigned long trocas ;
+   unsigned int inicio ;
+
+   soma = 0 ;
+   sem_create (&s, 0) ;
+   sem_setflags (&s, flags) ;
+
+   trocas = ppos_switches () ;
+   inicio = systime () ;
+
+   // todas as tarefas começam na fila do semáforo, formando o comboio
+   for (i=0; i<NUMTASKS; i++)
+     task_create (&task[i], taskBody, "Task") ;
+   task_sleep (10) ;
+   sem_up (&s) ;
+
+   for (i=0; i<NUMTASKS; i++)
+     task_join (&task[i]) ;
+
+   trocas = ppos_switches () - trocas ;
+
+   printf ("%-8s: soma %ld (%s), %lu trocas, %.6f trocas/operacao, %u ms\n",
+           nome, soma, soma == NUMTASKS*NUMSTEPS ? "ok" : "ERRADA", trocas,
+           (double) trocas / (NUMTASKS*NUMSTEPS), systime() - inicio) ;
+
+   sem_destroy (&s) ;
+}
+
+int main (int argc, char *argv[])
+{
+   printf ("main: inicio\n") ;
+
+   ppos_init () ;
+
+   printf ("%d tarefas somando %d vezes cada, aguarde...\n",
+           NUMTASKS, NUMSTEPS) ;
+
+   rodada ("padrao", 0) ;
+   rodada ("handoff", SEM_HANDOFF) ;
+
+   task_exit (0) ;
+
+   exit (0) ;
+}
@@ -0,0 +1,97 @@
+// PingPongOS - PingPong Operating System
+
+// Vazão de filas de mensagens com inteiros pequenos: uma mensagem por
+// chamada (mqueue_send/recv) contra lotes (mqueue_send_n/recv_n), em filas
+// comuns e em filas MQUEUE_SPSC
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "ppos.h"
+
+#define NUMMSGS  2000000
+#define QUEUELEN 64
+#define BATCH    32
+
+task_t prod, cons ;
+mqueue_t fila ;
+int lote ;			// mensagens por chamada na rodada atual
+long soma ;
+
+void prodBody (void * arg)
+{
+   int valores[BATCH] ;
+   int i, j, n ;
+
+   for (i=0; i<NUMMSGS; i+=n)
+   {
+      if (lote == 1)
+      {
+         valores[0] = i ;
+         n = mqueue_send (&fila, valores) == 0 ;
+      }
+      else
+      {
+         n = NUMMSGS - i < lote ? NUMMSGS - i : lote ;
+         for (j=0; j<n; j++)
+            valores[j] = i + j ;
+         n = mqueue_send_n (&fila, valores, n) ;
+      }
+   }
+   task_exit (0) ;
+}
+
+void consBody (void * arg)
+{
+   int valores[BATCH] ;
+   int i, j, n ;
+
+   for (i=0; i<NUMMSGS; i+=n)
+   {
+      if (lote == 1)
+         n = mqueue_recv (&fila, valores) == 0 ;
+      else
+         n = mqueue_recv_n (&fila, valores,
+                            NUMMSGS - i < lote ? NUMMSGS - i : lote) ;
+      for (j=0; j<n; j++)
+         soma += valores[j] ;
+   }
+   task_exit (0) ;
+}
+
+void rodada (int tamanho, int flags)
+{
+   unsigned int inicio, tempo ;
+
+   lote = tamanho ;
+   soma = 0 ;
+   mqueue_create_flags (&fila, QUEUELEN, sizeof(int), flags) ;
+
+   inicio = systime () ;
+   task_create (&prod, prodBody, NULL) ;
+   task_create (&cons, consBody, NULL) ;
+   task_join (&prod) ;
+   task_join (&cons) ;
+   tempo = systime () - inicio ;
+
+   printf ("%-6s lote %2d: %d mensagens em %5u ms, %9.0f mensagens/s, soma %s\n",
+           flags & MQUEUE_SPSC ? "spsc" : "comum", tamanho, NUMMSGS, tempo, NUMMSGS * 1000.0 / (tempo ? tempo : 1),
+           soma == (long) NUMMSGS * (NUMMSGS - 1) / 2 ? "ok" : "ERRADA") ;
+
+   mqueue_destroy (&fila) ;
+}
+
+int main (int argc, char *argv[])
+{
+   printf ("main: inicio\n") ;
+
+   ppos_init () ;
+
+   rodada (1, 0) ;
+   rodada (BATCH, 0) ;
+   rodada (1, MQUEUE_SPSC) ;
+   rodada (BATCH, MQUEUE_SPSC) ;
+
+   task_exit (0) ;
+
+   exit (0) ;
+}
@@ -0,0 +1,145 @@
+// PingPongOS - PingPong Operating System
+
+// Teste das políticas de fila cheia: um produtor rápido envia NUMMSGS
+// números em sequência para um consumidor lento. Com MQUEUE_BLOCK o produtor
+// espera o consumidor; com descarte ele nunca espera, e o consumidor recebe
+// as primeiras (DROP_NEWEST) ou as últimas (DROP_OLDEST) mensagens. Também
+// confere o descarte com mqueue_send_prio e com lotes de mqueue_send_n.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "ppos.h"
+
+#define NUMMSGS  500
+#define QUEUELEN 16
+#define FIM      -1
+
+task_t prod, cons ;
+mqueue_t fila ;
+
+void prodBody (void * arg)
+{
+   int i, fim = FIM ;
+   unsigned int inicio = systime () ;
+   unsigned long trocas = ppos_switches () ;
+
+   for (i=0; i<NUMMSGS; i++)
+      mqueue_send (&fila, &i) ;
+
+   printf ("  produtor: %d envios em %3d ms, %4lu trocas de contexto\n",
+           NUMMSGS, systime() - inicio, ppos_switches() - trocas) ;
+
+   // o fim não pode ser descartado
+   mqueue_set_overflow (&fila, MQUEUE_BLOCK) ;
+   mqueue_send (&fila, &fim) ;
+   task_exit (0) ;
+}
+
+void consBody (void * arg)
+{
+   int valor, recebidas = 0, primeira = -1, ultima = -1, ordem = 1 ;
+
+   while (mqueue_recv (&fila, &valor) == 0 && valor != FIM)
+   {
+      if (primeira < 0)
+         primeira = valor ;
+      ordem = ordem && valor > ultima ;
+      ultima = valor ;
+      recebidas++ ;
+      task_sleep (1) ;
+   }
+   printf ("  consumidor: %d recebidas (%d a %d), %d descartadas, %s\n",
+           recebidas, primeira, ultima, mqueue_dropped (&fila),
+           recebidas + mqueue_dropped (&fila) == NUMMSGS && ordem ? "ok" : "ERRO") ;
+   task_exit (0) ;
+}
+
+void rodada (int policy, char *nome)
+{
+   printf ("%s:\n", nome) ;
+   mqueue_create (&fila, QUEUELEN, sizeof(int)) ;
+   mqueue_set_overflow (&fila, policy) ;
+
+   task_create (&cons, consBody, NULL) ;
+   task_create (&prod, prodBody, NULL) ;
+
+   task_join (&prod) ;
+   task_join (&cons) ;
+
+   mqueue_destroy (&fila) ;
+}
+
+// mqueue_send_prio segue a política como mqueue_send: o descarte não é erro
+void rodada_prio ()
+{
+   int i, erros = 0 ;
+
+   printf ("MQUEUE_PRIO com MQUEUE_DROP_NEWEST:\n") ;
+   mqueue_create_flags (&fila, QUEUELEN, sizeof(int), MQUEUE_PRIO) ;
+   mqueue_set_overflow (&fila, MQUEUE_DROP_NEWEST) ;
+
+   for (i=0; i<QUEUELEN+4; i++)
+      if (mqueue_send_prio (&fila, &i, i % 2) != 0)
+         erros++ ;
+
+   printf ("  %d envios, %d com erro, %d descartadas, %s\n", QUEUELEN+4,
+           erros, mqueue_dropped (&fila),
+           erros == 0 && mqueue_dropped (&fila) == 4 ? "ok" : "ERRO") ;
+   mqueue_destroy (&fila) ;
+}
+
+// mqueue_send_n com DROP_OLDEST abre espaço para o lote descartando as
+// mensagens mais antigas da fila; um lote maior que a fila mantém o seu final
+void rodada_lote ()
+{
+   int i, lote[QUEUELEN+4], valor, esperado, erros = 0 ;
+
+   printf ("mqueue_send_n com MQUEUE_DROP_OLDEST:\n") ;
+   mqueue_create (&fila, QUEUELEN, sizeof(int)) ;
+   mqueue_set_overflow (&fila, MQUEUE_DROP_OLDEST) ;
+
+   // 10 avulsas e um lote de 10: as 4 mais antigas dão lugar ao lote
+   for (i=0; i<10; i++)
+      mqueue_send (&fila, &i) ;
+   for (i=0; i<10; i++)
+      lote[i] = 10 + i ;
+   mqueue_send_n (&fila, lote, 10) ;
+
+   for (esperado=4; esperado<20; esperado++)
+      if (mqueue_recv (&fila, &valor) < 0 || valor != esperado)
+         erros++ ;
+
+   // fila cheia e lote maior que ela: ficam as últimas QUEUELEN do lote
+   for (i=0; i<QUEUELEN; i++)
+      mqueue_send (&fila, &i) ;
+   for (i=0; i<QUEUELEN+4; i++)
+      lote[i] = 100 + i ;
+   mqueue_send_n (&fila, lote, QUEUELEN+4) ;
+
+   for (esperado=104; esperado<100+QUEUELEN+4; esperado++)
+      if (mqueue_recv (&fila, &valor) < 0 || valor != esperado)
+         erros++ ;
+
+   printf ("  %d fora de ordem, %d descartadas, %s\n", erros,
+           mqueue_dropped (&fila),
+           erros == 0 && mqueue_dropped (&fila) == 4 + QUEUELEN + 4 ? "ok" : "ERRO") ;
+   mqueue_destroy (&fila) ;
+}
+
+int main (int argc, char *argv[])
+{
+   printf ("main: inicio\n") ;
+
+   ppos_init () ;
+
+   rodada (MQUEUE_BLOCK, "MQUEUE_BLOCK") ;
+   rodada (MQUEUE_DROP_NEWEST, "MQUEUE_DROP_NEWEST") ;
+   rodada (MQUEUE_DROP_OLDEST, "MQUEUE_DROP_OLDEST") ;
+   rodada_prio () ;
+   rodada_lote () ;
+
+   printf ("main: fim\n") ;
+   task_exit (0) ;
+
+   exit (0) ;
+}
@@ -0,0 +1,102 @@
+// PingPongOS - PingPong Operating System
+
+// Latência de mensagens de controle atrás de tráfego em massa: uma fila
+// comum (FIFO) contra uma fila MQUEUE_PRIO em que o controle é enviado com
+// o nível mais urgente
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "ppos.h"
+
+#define QUEUELEN 64		// vagas da fila
+#define NUMCTRL  20		// mensagens de controle por rodada
+#define PERIODO  20		// intervalo entre mensagens de controle (ms)
+
+typedef struct
+{
+   int controle ;		// 1 para controle, 0 para dados
+   unsigned int envio ;		// instante de envio
+} mensagem_t ;
+
+task_t massa, controle, cons ;
+mqueue_t fila ;
+int prioridade ;		// rodada com MQUEUE_PRIO?
+
+void massaBody (void * arg)
+{
+   mensagem_t m = {0, 0} ;
+
+   // enche a fila até ela ser destruída
+   while (mqueue_send (&fila, &m) == 0) ;
+   task_exit (0) ;
+}
+
+void controleBody (void * arg)
+{
+   mensagem_t m = {1, 0} ;
+   int i ;
+
+   for (i=0; i<NUMCTRL; i++)
+   {
+      task_sleep (PERIODO) ;
+      m.envio = systime () ;
+      if (prioridade)
+         mqueue_send_prio (&fila, &m, 0) ;
+      else
+         mqueue_send (&fila, &m) ;
+   }
+   task_exit (0) ;
+}
+
+void consBody (void * arg)
+{
+   mensagem_t m ;
+   int recebidas = 0 ;
+   unsigned int latencia, soma = 0, pior = 0 ;
+
+   while (recebidas < NUMCTRL)
+   {
+      mqueue_recv (&fila, &m) ;
+      if (m.controle)
+      {
+         latencia = systime () - m.envio ;
+         soma += latencia ;
+         pior = latencia > pior ? latencia : pior ;
+         recebidas++ ;
+      }
+      task_sleep (1) ;		// custo de tratar cada mensagem
+   }
+   printf ("%-5s: controle com latência média %3d ms, pior %3d ms\n",
+           prioridade ? "prio" : "fifo", soma / NUMCTRL, pior) ;
+   task_exit (0) ;
+}
+
+void rodada (int flags)
+{
+   prioridade = flags & MQUEUE_PRIO ;
+   mqueue_create_flags (&fila, QUEUELEN, sizeof(mensagem_t), flags) ;
+
+   task_create (&massa, massaBody, NULL) ;
+   task_create (&controle, controleBody, NULL) ;
+   task_create (&cons, consBody, NULL) ;
+
+   task_join (&controle) ;
+   task_join (&cons) ;
+   mqueue_destroy (&fila) ;	// libera o produtor em massa
+   task_join (&massa) ;
+}
+
+int main (int argc, char *argv[])
+{
+   printf ("main: inicio\n") ;
+
+   ppos_init () ;
+
+   rodada (0) ;
+   rodada (MQUEUE_PRIO) ;
+
+   printf ("main: fim\n") ;
+   task_exit (0) ;
+
+   exit (0) ;
+}
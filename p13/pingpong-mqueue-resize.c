@@ -0,0 +1,86 @@
+// PingPongOS - PingPong Operating System
+
+// Teste de fila redimensionável: uma rajada de RAJADA mensagens encontra a
+// fila de QUEUELEN vagas com o consumidor ainda parado, e a fila cresce em
+// vez de bloquear o produtor; depois, com tráfego leve, ela volta a encolher.
+// Com o consumidor ativo, a mesma rajada é absorvida sem a fila crescer.
+// A ordem das mensagens é conferida através dos redimensionamentos.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "ppos.h"
+
+#define QUEUELEN 4
+#define LIMITE   256
+#define RAJADA   200
+#define LEVES    1000
+
+task_t prod, cons ;
+mqueue_t fila ;
+
+void prodBody (void * arg)
+{
+   int i ;
+   unsigned long trocas = ppos_switches () ;
+
+   for (i=0; i<RAJADA; i++)
+      mqueue_send (&fila, &i) ;
+   printf ("rajada de %d: %lu trocas de contexto, fila com %d vagas\n",
+           RAJADA, ppos_switches() - trocas, fila.max_msgs) ;
+
+   for (; i<RAJADA+LEVES; i++)
+   {
+      mqueue_send (&fila, &i) ;
+      task_sleep (1) ;
+   }
+   task_exit (0) ;
+}
+
+void consBody (void * arg)
+{
+   int i, valor, erros = 0, maior = 0 ;
+
+   if (arg)
+      task_sleep (50) ;		// deixa a rajada encontrar a fila parada
+   for (i=0; i<RAJADA+LEVES; i++)
+   {
+      mqueue_recv (&fila, &valor) ;
+      if (valor != i)
+         erros++ ;
+      if (fila.max_msgs > maior)
+         maior = fila.max_msgs ;
+   }
+   printf ("consumidor: %d mensagens, %d fora de ordem, fila chegou a %d e "
+           "terminou com %d vagas\n", RAJADA+LEVES, erros, maior, fila.max_msgs) ;
+   task_exit (0) ;
+}
+
+void rodada (char *nome, int parado)
+{
+   printf ("%s:\n", nome) ;
+   mqueue_create (&fila, QUEUELEN, sizeof(int)) ;
+   mqueue_set_resize (&fila, QUEUELEN, LIMITE) ;
+
+   task_create (&prod, prodBody, NULL) ;
+   task_create (&cons, consBody, (void *) (long) parado) ;
+
+   task_join (&prod) ;
+   task_join (&cons) ;
+
+   mqueue_destroy (&fila) ;
+}
+
+int main (int argc, char *argv[])
+{
+   printf ("main: inicio\n") ;
+
+   ppos_init () ;
+
+   rodada ("consumidor parado", 1) ;
+   rodada ("consumidor ativo", 0) ;
+
+   printf ("main: fim\n") ;
+   task_exit (0) ;
+
+   exit (0) ;
+}
@@ -0,0 +1,130 @@
+// PingPongOS - PingPong Operating System
+
+// Teste de fila compartilhada entre dois processos ppos: o filho produz
+// NUMMSGS mensagens montadas direto no segmento (reserve/commit) e o pai as
+// consome; enquanto o consumidor do pai espera, outra tarefa do pai continua
+// executando, mostrando que só a tarefa bloqueia, não o processo. Sem
+// tarefas prontas, o pai dorme em vez de girar esperando o filho.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <time.h>
+#include "ppos.h"
+
+#define NOME     "/ppos-pingpong-shm"
+#define NUMMSGS  100
+#define QUEUELEN 4
+
+typedef struct
+{
+   int seq ;
+   int pid ;
+} mensagem_t ;
+
+task_t prod, cons, relogio ;
+mqueue_t fila ;
+int fim = 0 ;
+
+void prodBody (void * arg)
+{
+   mensagem_t *m ;
+   int i ;
+
+   for (i=0; i<NUMMSGS; i++)
+   {
+      m = mqueue_send_reserve (&fila) ;
+      m->seq = i ;
+      m->pid = getpid () ;
+      mqueue_send_commit (&fila) ;
+      task_sleep (2) ;
+   }
+   task_exit (0) ;
+}
+
+void consBody (void * arg)
+{
+   mensagem_t m ;
+   int i, erros = 0 ;
+
+   for (i=0; i<NUMMSGS; i++)
+   {
+      mqueue_recv (&fila, &m) ;
+      if (m.seq != i || m.pid == getpid ())
+         erros++ ;
+   }
+   printf ("Consumidor recebeu %d mensagens de outro processo, %d erros\n",
+           NUMMSGS, erros) ;
+   fim = 1 ;
+   task_exit (0) ;
+}
+
+void relogioBody (void * arg)
+{
+   int ticks = 0 ;
+
+   while (!fim)
+   {
+      task_sleep (10) ;
+      ticks++ ;
+   }
+   printf ("Relógio do mesmo processo avançou %s\n",
+           ticks > NUMMSGS * 2 / 10 / 2 ? "normalmente" : "POUCO") ;
+   task_exit (0) ;
+}
+
+int main (int argc, char *argv[])
+{
+   pid_t filho ;
+   int status, result ;
+   mensagem_t m ;
+   unsigned int inicio ;
+
+   printf ("main: inicio\n") ;
+
+   mqueue_unlink_shared (NOME) ;	// restos de execuções anteriores
+   fflush (stdout) ;
+   filho = fork () ;
+
+   ppos_init () ;
+
+   if (mqueue_open_shared (&fila, NOME, QUEUELEN, sizeof(mensagem_t)) < 0)
+   {
+      printf ("Erro ao abrir a fila compartilhada\n") ;
+      exit (1) ;
+   }
+
+   if (filho == 0)
+   {
+      task_create (&prod, prodBody, NULL) ;
+      task_join (&prod) ;
+      mqueue_destroy (&fila) ;
+      task_exit (0) ;
+      exit (0) ;
+   }
+
+   task_create (&cons, consBody, NULL) ;
+   task_create (&relogio, relogioBody, NULL) ;
+   task_join (&cons) ;
+   task_join (&relogio) ;
+
+   // o filho não envia mais nada: a espera com prazo expira
+   inicio = systime () ;
+   result = mqueue_recv_timed (&fila, &m, 50) ;
+   printf ("Recebimento com prazo de 50 ms na fila vazia: %d em %u ms\n",
+           result, systime () - inicio) ;
+
+   mqueue_destroy (&fila) ;
+   mqueue_unlink_shared (NOME) ;
+   waitpid (filho, &status, 0) ;
+
+   // o filho dorme 2 ms por mensagem: girando, o pai gastaria o tempo todo
+   printf ("Processo pai %s enquanto esperava\n",
+           clock () * 1000 / CLOCKS_PER_SEC < NUMMSGS * 2 / 2 ? "dormiu" : "GIROU") ;
+
+   printf ("main: fim\n") ;
+   task_exit (0) ;
+
+   exit (0) ;
+}
@@ -0,0 +1,71 @@
+// PingPongOS - PingPong Operating System
+
+// Teste das estatísticas de filas: o produtor envia rajadas maiores que a
+// fila e o consumidor trata uma mensagem por ms; as estatísticas são
+// conferidas com mqueue_stats e impressas em mqueue_destroy (MQUEUE_STATS)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "ppos.h"
+
+#define NUMMSGS  200
+#define RAJADA   20
+#define QUEUELEN 8
+
+task_t prod, cons ;
+mqueue_t fila ;
+
+void prodBody (void * arg)
+{
+   int i ;
+
+   for (i=0; i<NUMMSGS; i++)
+   {
+      mqueue_send (&fila, &i) ;
+      if (i % RAJADA == RAJADA-1)
+         task_sleep (30) ;	// pausa entre rajadas
+   }
+   task_exit (0) ;
+}
+
+void consBody (void * arg)
+{
+   int i, valor ;
+
+   for (i=0; i<NUMMSGS; i++)
+   {
+      mqueue_recv (&fila, &valor) ;
+      task_sleep (1) ;
+   }
+   task_exit (0) ;
+}
+
+int main (int argc, char *argv[])
+{
+   mqueue_stats_t st ;
+
+   printf ("main: inicio\n") ;
+
+   ppos_init () ;
+
+   mqueue_create_flags (&fila, QUEUELEN, sizeof(int), MQUEUE_STATS) ;
+
+   task_create (&prod, prodBody, NULL) ;
+   task_create (&cons, consBody, NULL) ;
+
+   task_join (&prod) ;
+   task_join (&cons) ;
+
+   mqueue_stats (&fila, &st) ;
+   printf ("envios %lu, recebimentos %lu, maior ocupação %d: %s\n",
+           st.sends, st.recvs, st.high_water,
+           st.sends == NUMMSGS && st.recvs == NUMMSGS && st.high_water == QUEUELEN
+           && st.send_blocks > 0 && st.recv_blocks > 0 ? "ok" : "ERRO") ;
+
+   mqueue_destroy (&fila) ;
+
+   printf ("main: fim\n") ;
+   task_exit (0) ;
+
+   exit (0) ;
+}
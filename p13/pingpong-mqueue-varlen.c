@@ -0,0 +1,103 @@
+// PingPongOS - PingPong Operating System
+
+// Teste de fila com mensagens de tamanho variável (MQUEUE_VARLEN): dois
+// produtores enviam registros de telemetria de 1 a MAXLEN bytes e o
+// consumidor confere o tamanho e o conteúdo de cada um
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ppos.h"
+
+#define NUMMSGS  1000		// mensagens por produtor
+#define MAXLEN   512		// tamanho máximo de uma mensagem
+#define QUEUELEN 2048		// capacidade da fila em bytes
+
+task_t prod[2], cons ;
+mqueue_t fila ;
+long bytes = 0 ;
+
+// tamanho típico de telemetria: a maioria pequena, algumas grandes
+int tamanho (int seq)
+{
+   return (seq % 10 == 0) ? MAXLEN : 4 + random() % 60 ;
+}
+
+void prodBody (void * arg)
+{
+   unsigned char msg[MAXLEN] ;
+   int i, len, id = (long) arg ;
+
+   for (i=0; i<NUMMSGS; i++)
+   {
+      len = tamanho (i) ;
+      msg[0] = id ;
+      msg[1] = i >> 8 ;
+      msg[2] = i & 0xff ;
+      memset (msg+3, 'a' + i % 26, len-3) ;
+      mqueue_send_var (&fila, msg, len) ;
+   }
+   task_exit (0) ;
+}
+
+void consBody (void * arg)
+{
+   unsigned char msg[MAXLEN] ;
+   int i, j, len, seq, erros = 0, proximo[2] = {0, 0} ;
+
+   for (i=0; i<2*NUMMSGS; i++)
+   {
+      len = mqueue_recv_var (&fila, msg) ;
+      seq = (msg[1] << 8) | msg[2] ;
+      if (len < 4 || msg[0] > 1 || seq != proximo[msg[0]])
+      {
+         erros++ ;
+         continue ;
+      }
+      proximo[msg[0]]++ ;
+      for (j=3; j<len; j++)
+         if (msg[j] != 'a' + seq % 26)
+         {
+            erros++ ;
+            break ;
+         }
+      bytes += len ;
+   }
+   printf ("Consumidor recebeu %d mensagens (%ld bytes), %d erros\n",
+           2*NUMMSGS, bytes, erros) ;
+   task_exit (0) ;
+}
+
+int main (int argc, char *argv[])
+{
+   printf ("main: inicio\n") ;
+
+   ppos_init () ;
+
+   if (mqueue_create_flags (&fila, QUEUELEN, MAXLEN, MQUEUE_VARLEN) < 0)
+   {
+      printf ("Erro na criação da fila\n") ;
+      exit (1) ;
+   }
+
+   task_create (&prod[0], prodBody, (void *) 0) ;
+   task_create (&prod[1], prodBody, (void *) 1) ;
+   task_create (&cons, consBody, NULL) ;
+
+   task_join (&prod[0]) ;
+   task_join (&prod[1]) ;
+   task_join (&cons) ;
+
+   printf ("Mensagens na fila ao final: %d\n", mqueue_msgs (&fila)) ;
+
+   // memória para a mesma quantidade média de mensagens com vagas fixas
+   printf ("Fila variável: %d bytes; fila fixa equivalente: %ld bytes\n",
+           QUEUELEN, (long) QUEUELEN / (bytes / (2*NUMMSGS) + sizeof(int)) * MAXLEN) ;
+
+   mqueue_destroy (&fila) ;
+
+   printf ("main: fim\n") ;
+   task_exit (0) ;
+
+   exit (0) ;
+}
@@ -0,0 +1,75 @@
+// PingPongOS - PingPong Operating System
+
+// Teste de envio e recepção sem cópia (reserve/commit e peek/release):
+// as mensagens são montadas e lidas diretamente nas vagas da fila
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ppos.h"
+
+#define NUMMSGS 10
+
+typedef struct
+{
+   int seq ;
+   char texto[1000] ;
+} mensagem_t ;
+
+task_t prod, cons ;
+mqueue_t fila ;
+
+void prodBody (void * arg)
+{
+   mensagem_t *m ;
+   int i ;
+
+   for (i=0; i<NUMMSGS; i++)
+   {
+      m = mqueue_send_reserve (&fila) ;
+      m->seq = i ;
+      sprintf (m->texto, "mensagem %d montada no lugar", i) ;
+      mqueue_send_commit (&fila) ;
+      printf ("T%d enviou %d\n", task_id(), i) ;
+      task_sleep (random() % 50) ;
+   }
+   task_exit (0) ;
+}
+
+void consBody (void * arg)
+{
+   mensagem_t *m ;
+   int i ;
+
+   for (i=0; i<NUMMSGS; i++)
+   {
+      m = mqueue_recv_peek (&fila) ;
+      printf ("                T%d recebeu %d: \"%s\"%s\n", task_id(), m->seq,
+              m->texto, m->seq == i ? "" : " FORA DE ORDEM") ;
+      mqueue_recv_release (&fila) ;
+      task_sleep (random() % 100) ;
+   }
+   task_exit (0) ;
+}
+
+int main (int argc, char *argv[])
+{
+   printf ("main: inicio\n") ;
+
+   ppos_init () ;
+
+   mqueue_create (&fila, 3, sizeof(mensagem_t)) ;
+
+   task_create (&prod, prodBody, NULL) ;
+   task_create (&cons, consBody, NULL) ;
+
+   task_join (&prod) ;
+   task_join (&cons) ;
+
+   mqueue_destroy (&fila) ;
+
+   printf ("main: fim\n") ;
+   task_exit (0) ;
+
+   exit (0) ;
+}
@@ -0,0 +1,102 @@
+// PingPongOS - PingPong Operating System
+
+// Teste de semáforo com fila de espera por prioridade (SEM_PRIO): tarefas de
+// três níveis de prioridade disputam um recurso mantido por alguns ms. A
+// mesma carga roda com a fila FIFO padrão e com SEM_PRIO; com SEM_PRIO as
+// tarefas mais prioritárias devem esperar menos (p50 e p99) que na FIFO.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "ppos.h"
+
+#define NUMTASKS 12
+#define NUMSTEPS 20
+#define NIVEIS   3
+#define AMOSTRAS (NUMTASKS / NIVEIS * NUMSTEPS)	// esperas por nível
+
+task_t task[NUMTASKS] ;
+semaphore_t  s ;
+unsigned int esperas[NIVEIS][AMOSTRAS] ;
+int amostras[NIVEIS] ;
+
+// corpo das threads
+void taskBody(void *arg)
+{
+   int i, nivel = (long) arg ;
+   unsigned int inicio ;
+
+   for (i=0; i< NUMSTEPS; i++)
+   {
+      inicio = systime () ;
+      sem_down (&s) ;
+      esperas[nivel][amostras[nivel]++] = systime () - inicio ;
+      task_sleep (2) ;		// segura o recurso
+      sem_up (&s) ;
+   }
+
+   task_exit (0) ;
+}
+
+int compara (const void *a, const void *b)
+{
+   unsigned int x = *(unsigned int *) a, y = *(unsigned int *) b ;
+   return (x > y) - (x < y) ;
+}
+
+// percentil p das esperas de um nível (ordena as amostras)
+unsigned int percentil (int nivel, int p)
+{
+   qsort (esperas[nivel], amostras[nivel], sizeof(unsigned int), compara) ;
+   return esperas[nivel][(amostras[nivel] - 1) * p / 100] ;
+}
+
+// roda a carga com as opções indicadas; devolve p50 e p99 do nível mais
+// prioritário
+void rodada (int flags, char *nome, unsigned int *p50, unsigned int *p99)
+{
+   long i ;
+
+   sem_create (&s, 1) ;
+   sem_setflags (&s, flags) ;
+   for (i=0; i<NIVEIS; i++)
+      amostras[i] = 0 ;
+
+   for (i=0; i<NUMTASKS; i++)
+   {
+     task_create (&task[i], taskBody, (void *) (i % NIVEIS)) ;
+     task_setprio (&task[i], (i % NIVEIS - 1) * 10) ;	// -10, 0 ou +10
+   }
+
+   for (i=0; i<NUMTASKS; i++)
+     task_join (&task[i]) ;
+
+   printf ("%s:\n", nome) ;
+   for (i=0; i<NIVEIS; i++)
+      printf ("  prio %3ld: p50 %3u ms, p99 %3u ms\n", (i - 1) * 10,
+              percentil (i, 50), percentil (i, 99)) ;
+   *p50 = percentil (0, 50) ;
+   *p99 = percentil (0, 99) ;
+
+   sem_print_stats (&s) ;
+   sem_destroy (&s) ;
+}
+
+int main (int argc, char *argv[])
+{
+   unsigned int fifo50, fifo99, prio50, prio99 ;
+
+   printf ("main: inicio\n") ;
+
+   ppos_init () ;
+
+   rodada (0, "FIFO", &fifo50, &fifo99) ;
+   rodada (SEM_PRIO, "SEM_PRIO", &prio50, &prio99) ;
+
+   printf ("prio -10 com SEM_PRIO espera menos que na FIFO: %s\n",
+           prio50 < fifo50 && prio99 < fifo99 ? "ok" : "ERRO") ;
+
+   printf ("main: fim\n") ;
+   task_exit (0) ;
+
+   exit (0) ;
+}
@@ -0,0 +1,130 @@
+// PingPongOS - PingPong Operating System
+
+// Teste das variantes com prazo (_timed) e não-bloqueantes (_try)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "ppos.h"
+
+task_t dorminhoca, liberadora, acordadora ;
+semaphore_t s ;
+mqueue_t fila, spsc ;
+int palavra = 0 ;
+
+// dorme um pouco e encerra com código 42
+void dormeBody (void * arg)
+{
+   task_sleep (500) ;
+   task_exit (42) ;
+}
+
+// libera o semáforo depois de 100 ms
+void liberaBody (void * arg)
+{
+   task_sleep (100) ;
+   sem_up (&s) ;
+   task_exit (0) ;
+}
+
+// muda a palavra e acorda quem espera nela depois de 100 ms
+void acordaBody (void * arg)
+{
+   task_sleep (100) ;
+   palavra = 1 ;
+   ppos_wake (&palavra, -1) ;
+   task_exit (0) ;
+}
+
+void mostra (char *oper, int result, unsigned int inicio)
+{
+   printf ("%-32s -> %3d (%4u ms)\n", oper, result, systime() - inicio) ;
+}
+
+int main (int argc, char *argv[])
+{
+   int valor = 7, result ;
+   unsigned int inicio ;
+
+   printf ("main: inicio\n") ;
+
+   ppos_init () ;
+
+   sem_create (&s, 0) ;
+   mqueue_create (&fila, 1, sizeof(int)) ;
+   mqueue_create_flags (&spsc, 1, sizeof(int), MQUEUE_SPSC) ;
+
+   inicio = systime () ;
+   result = sem_down_try (&s) ;
+   mostra ("sem_down_try (vazio)", result, inicio) ;
+
+   inicio = systime () ;
+   result = sem_down_timed (&s, 50) ;
+   mostra ("sem_down_timed (50, vazio)", result, inicio) ;
+
+   task_create (&liberadora, liberaBody, NULL) ;
+   inicio = systime () ;
+   result = sem_down_timed (&s, 1000) ;
+   mostra ("sem_down_timed (1000, up em 100)", result, inicio) ;
+
+   inicio = systime () ;
+   result = mqueue_recv_timed (&fila, &valor, 50) ;
+   mostra ("mqueue_recv_timed (50, vazia)", result, inicio) ;
+
+   inicio = systime () ;
+   result = mqueue_send_try (&fila, &valor) ;
+   mostra ("mqueue_send_try (vazia)", result, inicio) ;
+
+   inicio = systime () ;
+   result = mqueue_send_timed (&fila, &valor, 50) ;
+   mostra ("mqueue_send_timed (50, cheia)", result, inicio) ;
+
+   inicio = systime () ;
+   result = mqueue_recv_try (&fila, &valor) ;
+   mostra ("mqueue_recv_try (cheia)", result, inicio) ;
+
+   inicio = systime () ;
+   result = mqueue_recv_timed (&spsc, &valor, 50) ;
+   mostra ("mqueue_recv_timed (50, spsc)", result, inicio) ;
+
+   inicio = systime () ;
+   result = ppos_wait_timed (&palavra, 0, 50) ;
+   mostra ("ppos_wait_timed (50, sem wake)", result, inicio) ;
+
+   task_create (&acordadora, acordaBody, NULL) ;
+   inicio = systime () ;
+   result = ppos_wait_timed (&palavra, 0, 1000) ;
+   mostra ("ppos_wait_timed (1000, wake 100)", result, inicio) ;
+
+   task_create (&dorminhoca, dormeBody, NULL) ;
+   inicio = systime () ;
+   result = task_join_try (&dorminhoca) ;
+   mostra ("task_join_try", result, inicio) ;
+
+   inicio = systime () ;
+   result = task_join_timed (&dorminhoca, 100) ;
+   mostra ("task_join_timed (100)", result, inicio) ;
+
+   inicio = systime () ;
+   result = task_join (&dorminhoca) ;
+   mostra ("task_join", result, inicio) ;
+
+   // a tarefa já terminou: as variantes devolvem o código sem esperar
+   inicio = systime () ;
+   result = task_join_try (&dorminhoca) ;
+   mostra ("task_join_try (terminada)", result, inicio) ;
+
+   inicio = systime () ;
+   result = task_join_timed (&dorminhoca, 100) ;
+   mostra ("task_join_timed (100, terminada)", result, inicio) ;
+
+   task_join (&liberadora) ;
+   task_join (&acordadora) ;
+   mqueue_destroy (&fila) ;
+   mqueue_destroy (&spsc) ;
+   sem_destroy (&s) ;
+
+   printf ("main: fim\n") ;
+   task_exit (0) ;
+
+   exit (0) ;
+}
@@ -0,0 +1,88 @@
+// PingPongOS - PingPong Operating System
+
+// Teste de espera múltipla: um único roteador consome de três filas de
+// mensagens alimentadas por produtores com ritmos diferentes
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "ppos.h"
+
+#define NUMQUEUES 3
+#define NUMMSGS   5
+
+task_t prod[NUMQUEUES], roteador ;
+mqueue_t fila[NUMQUEUES] ;
+
+// corpo dos produtores: a fila i recebe uma mensagem a cada (i+1)*100 ms
+void prodBody (void * arg)
+{
+   long i = (long) arg ;
+   int j, valor ;
+
+   for (j=0; j<NUMMSGS; j++)
+   {
+      task_sleep ((i+1) * 100) ;
+      valor = i * 100 + j ;
+      mqueue_send (&fila[i], &valor) ;
+   }
+   task_exit (0) ;
+}
+
+// corpo do roteador: espera em todas as filas ao mesmo tempo
+void roteadorBody (void * arg)
+{
+   waitobj_t objs[NUMQUEUES] ;
+   int i, pronta, valor, recebidas = 0 ;
+
+   for (i=0; i<NUMQUEUES; i++)
+   {
+      objs[i].type = WAITOBJ_MQUEUE ;
+      objs[i].object = &fila[i] ;
+   }
+
+   while (recebidas < NUMQUEUES * NUMMSGS)
+   {
+      pronta = ppos_wait_any (objs, NUMQUEUES, 1000) ;
+      if (pronta < 0)
+      {
+         printf ("T%d: nenhuma fila pronta (%d)\n", task_id(), pronta) ;
+         break ;
+      }
+      mqueue_recv (&fila[pronta], &valor) ;
+      recebidas++ ;
+      printf ("T%d: fila %d entregou %3d em %4u ms\n",
+              task_id(), pronta, valor, systime()) ;
+   }
+
+   // nenhum produtor ativo: o prazo deve expirar
+   pronta = ppos_wait_any (objs, NUMQUEUES, 200) ;
+   printf ("T%d: espera sem produtores retornou %d\n", task_id(), pronta) ;
+
+   task_exit (0) ;
+}
+
+int main (int argc, char *argv[])
+{
+   long i ;
+
+   printf ("main: inicio\n") ;
+
+   ppos_init () ;
+
+   for (i=0; i<NUMQUEUES; i++)
+     mqueue_create (&fila[i], 5, sizeof(int)) ;
+
+   task_create (&roteador, roteadorBody, NULL) ;
+   for (i=0; i<NUMQUEUES; i++)
+     task_create (&prod[i], prodBody, (void *) i) ;
+
+   task_join (&roteador) ;
+
+   for (i=0; i<NUMQUEUES; i++)
+     mqueue_destroy (&fila[i]) ;
+
+   printf ("main: fim\n") ;
+   task_exit (0) ;
+
+   exit (0) ;
+}
@@ -29,6 +29,9 @@
 // Inicializa o sistema operacional; deve ser chamada no inicio do main()
 void ppos_init () ;
 
+// retorna o número de trocas de contexto feitas desde ppos_init()
+unsigned long ppos_switches () ;
+
 // gerência de tarefas =========================================================
 
 // Cria uma nova tarefa. Retorna um ID> 0 ou erro.
@@ -62,6 +65,28 @@ int task_getprio (task_t *task) ;
 // a tarefa corrente aguarda o encerramento de outra task
 int task_join (task_t *task) ;
 
+// espera em endereço arbitrário (estilo futex): suspende a tarefa corrente
+// se *addr == expected. Retorna 0 ao ser acordada ou -1 se *addr != expected
+int ppos_wait (int *addr, int expected) ;
+
+// acorda até n tarefas esperando em addr (n < 0: todas).
+// Retorna o número de tarefas acordadas
+int ppos_wake (int *addr, int n) ;
+
+// variantes com prazo (_timed, em ms) e não-bloqueantes (_try) das operações
+// bloqueantes; além dos erros usuais, podem retornar:
+#define PPOS_ETIMEDOUT	-2	// o prazo expirou antes da operação completar
+#define PPOS_EAGAIN	-3	// a operação _try teria que bloquear
+
+// ppos_wait esperando no máximo ms milissegundos
+int ppos_wait_timed (int *addr, int expected, int ms) ;
+
+// aguarda o encerramento de outra task por até ms milissegundos
+int task_join_timed (task_t *task, int ms) ;
+
+// obtém o código de encerramento de uma task, se ela já terminou
+int task_join_try (task_t *task) ;
+
 // operações de gestão do tempo ================================================
 
 // suspende a tarefa corrente por t milissegundos
@@ -80,12 +105,29 @@ int sem_create (semaphore_t *s, int value) ;
 // requisita o semáforo
 int sem_down (semaphore_t *s) ;
 
+// requisita o semáforo, esperando no máximo ms milissegundos
+int sem_down_timed (semaphore_t *s, int ms) ;
+
+// requisita o semáforo somente se isso não bloquear a tarefa
+int sem_down_try (semaphore_t *s) ;
+
 // libera o semáforo
 int sem_up (semaphore_t *s) ;
 
 // destroi o semáforo, liberando as tarefas bloqueadas
 int sem_destroy (semaphore_t *s) ;
 
+// opções de semáforo, combináveis com "|"
+#define SEM_HANDOFF	0x1	// sem_up cede o processador direto à tarefa acordada
+#define SEM_PRIO	0x2	// acorda primeiro a tarefa mais prioritária
+
+// define as opções do semáforo (0 = comportamento padrão); SEM_PRIO só
+// pode ser alterado com a fila de espera vazia
+int sem_setflags (semaphore_t *s, int flags) ;
+
+// imprime os percentis de tempo de espera por nível de prioridade (SEM_PRIO)
+void sem_print_stats (semaphore_t *s) ;
+
 // mutexes
 
 // Inicializa um mutex (sempre inicialmente livre)
@@ -116,18 +158,138 @@ int barrier_destroy (barrier_t *b) ;
 // cria uma fila para até max mensagens de size bytes cada
 int mqueue_create (mqueue_t *queue, int max, int size) ;
 
+// opções de fila de mensagens, combináveis com "|"
+#define MQUEUE_SPSC	0x1	// um único produtor e um único consumidor: anel
+				// sem semáforos, com índices atômicos (max
+				// potência de 2)
+#define MQUEUE_VARLEN	0x2	// mensagens de tamanho variável: max é a
+				// capacidade em bytes e size o tamanho máximo
+#define MQUEUE_PRIO	0x4	// recv entrega sempre a mensagem mais urgente;
+				// mqueue_send usa o nível menos urgente
+#define MQUEUE_STATS	0x8	// coleta estatísticas e as imprime em
+				// mqueue_destroy
+#define MQUEUE_SHARED	0x10	// fila entre processos (só por mqueue_open_shared)
+
+// cria uma fila com as opções indicadas; filas MQUEUE_SPSC não podem ser
+// usadas em ppos_wait_any
+int mqueue_create_flags (mqueue_t *queue, int max, int size, int flags) ;
+
 // envia uma mensagem para a fila
 int mqueue_send (mqueue_t *queue, void *msg) ;
 
 // recebe uma mensagem da fila
 int mqueue_recv (mqueue_t *queue, void *msg) ;
 
+// variantes de mqueue_send/mqueue_recv com prazo e não-bloqueantes
+int mqueue_send_timed (mqueue_t *queue, void *msg, int ms) ;
+int mqueue_send_try (mqueue_t *queue, void *msg) ;
+int mqueue_recv_timed (mqueue_t *queue, void *msg, int ms) ;
+int mqueue_recv_try (mqueue_t *queue, void *msg) ;
+
+// envio e recepção sem cópia: reserve/peek devolvem um ponteiro para a vaga
+// do anel (ou NULL em erro); a mensagem é montada/lida no lugar e a vaga só é
+// entregue com commit/release. Entre as duas chamadas os demais produtores
+// (ou consumidores) da fila ficam bloqueados
+void *mqueue_send_reserve (mqueue_t *queue) ;
+int mqueue_send_commit (mqueue_t *queue) ;
+void *mqueue_recv_peek (mqueue_t *queue) ;
+int mqueue_recv_release (mqueue_t *queue) ;
+
+// envio e recepção em lote: movem até n mensagens contíguas (no vetor msgs)
+// com uma única aquisição da fila. Bloqueiam só até haver uma vaga (ou uma
+// mensagem) e retornam quantas mensagens foram movidas, ou erro (< 0)
+int mqueue_send_n (mqueue_t *queue, void *msgs, int n) ;
+int mqueue_recv_n (mqueue_t *queue, void *msgs, int n) ;
+
+// envia uma mensagem com nível de urgência prio (0 a MQUEUE_PRIO_LEVELS-1,
+// 0 é o mais urgente) para uma fila MQUEUE_PRIO
+int mqueue_send_prio (mqueue_t *queue, void *msg, int prio) ;
+
+// envia uma mensagem de len bytes (até o tamanho máximo) para uma fila
+// MQUEUE_VARLEN; cada mensagem ocupa len + sizeof(int) bytes da fila
+int mqueue_send_var (mqueue_t *queue, void *msg, int len) ;
+
+// recebe a próxima mensagem de uma fila MQUEUE_VARLEN em msg, que deve ter
+// espaço para o tamanho máximo; retorna o tamanho da mensagem ou -1
+int mqueue_recv_var (mqueue_t *queue, void *msg) ;
+
+// políticas para envio com a fila cheia
+#define MQUEUE_BLOCK		0	// o produtor espera uma vaga (padrão)
+#define MQUEUE_DROP_NEWEST	1	// a mensagem enviada é descartada
+#define MQUEUE_DROP_OLDEST	2	// a mensagem mais antiga é descartada
+					// (só filas comuns); se um consumidor
+					// está no meio de um recebimento, a
+					// mais antiga é a dele e a enviada é
+					// descartada no lugar dela
+
+// define a política da fila; com descarte, mqueue_send nunca espera vaga e
+// retorna 0 mesmo descartando, mqueue_send_reserve retorna NULL e
+// mqueue_send_n envia o que couber, descartando o resto (com DROP_OLDEST,
+// descarta uma mensagem antiga por mensagem excedente e, se o lote for maior
+// que a fila, envia as últimas do lote)
+int mqueue_set_overflow (mqueue_t *queue, int policy) ;
+
+// informa quantas mensagens a política de descarte já eliminou
+int mqueue_dropped (mqueue_t *queue) ;
+
+// permite que uma fila comum dobre de tamanho (até max_limit vagas) quando um
+// produtor passa 10 ms esperando vaga com ela cheia e caia pela metade (até
+// min_limit) quando fica quase vazia; não há redimensionamento enquanto
+// alguém usa uma vaga obtida por mqueue_send_reserve/mqueue_recv_peek
+int mqueue_set_resize (mqueue_t *queue, int min_limit, int max_limit) ;
+
+// abre a fila name em memória compartilhada, criando-a se não existir, para
+// trocar mensagens com outros processos ppos; max (potência de 2) e size
+// devem coincidir com os de quem a criou. Funciona como uma fila comum (inclusive sem cópia com
+// reserve/peek), exceto por ppos_wait_any e políticas de descarte; esperar
+// bloqueia só a tarefa. mqueue_destroy desfaz só o mapeamento local.
+int mqueue_open_shared (mqueue_t *queue, const char *name, int max, int size) ;
+
+// remove o nome da fila compartilhada do sistema
+int mqueue_unlink_shared (const char *name) ;
+
+// copia as estatísticas de uma fila MQUEUE_STATS para stats
+int mqueue_stats (mqueue_t *queue, mqueue_stats_t *stats) ;
+
+// imprime as estatísticas de uma fila MQUEUE_STATS
+void mqueue_print_stats (mqueue_t *queue) ;
+
 // destroi a fila, liberando as tarefas bloqueadas
 int mqueue_destroy (mqueue_t *queue) ;
 
 // informa o número de mensagens atualmente na fila
 int mqueue_msgs (mqueue_t *queue) ;
 
+// canais de difusão: cada mensagem publicada é lida por todos os assinantes
+#define CHANNEL_BLOCK	0	// o produtor espera o assinante mais lento
+#define CHANNEL_LAP	1	// o produtor nunca espera; o assinante lento
+				// perde as mensagens mais antigas (max >= 2)
+
+// cria um canal para até max mensagens de size bytes cada (max potência de 2)
+int channel_create (channel_t *channel, int max, int size, int policy) ;
+
+// inscreve o assinante, que recebe as mensagens publicadas daqui em diante
+int channel_subscribe (channel_t *channel, subscriber_t *sub) ;
+
+// cancela a inscrição do assinante
+int channel_unsubscribe (subscriber_t *sub) ;
+
+// publica uma mensagem para todos os assinantes
+int channel_publish (channel_t *channel, void *msg) ;
+
+// recebe a próxima mensagem do assinante; as perdas ficam em sub->lost
+int channel_recv (subscriber_t *sub, void *msg) ;
+
+// destroi o canal, liberando as tarefas bloqueadas
+int channel_destroy (channel_t *channel) ;
+
+// espera múltipla
+
+// bloqueia a tarefa corrente até que um dos n objetos fique pronto, por até
+// ms milissegundos (ms < 0: sem prazo). Retorna o índice do objeto pronto;
+// a operação em si (sem_down, mqueue_recv) deve ser feita em seguida
+int ppos_wait_any (waitobj_t *objs, int n, int ms) ;
+
 //==============================================================================
 
 // Redefinir funcoes POSIX "proibidas" como "FORBIDDEN" (gera erro ao compilar)
@@ -3,15 +3,25 @@
 /******             Enzo Maruffa Moreira - GRR20171626                    ******/
 /*******************************************************************************/
 
+#define _DEFAULT_SOURCE // syscall(), fora do _XOPEN_SOURCE usado na compilação
 #include <stdlib.h>
 #include <stdio.h>
 #include <ucontext.h>
 #include <signal.h>
 #include <sys/time.h>
 #include <strings.h>
+#include <string.h>
 #include "ppos.h"
 #include "queue.h"
 #include "ppos_disk.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 
 #define STACKSIZE 32768
 
@@ -25,12 +35,23 @@
 #define TASK_SLEEPING 2
 #define DEFAULT_EXIT_CODE 0
 
+#define FUTEX_TABLE_SIZE 64 // deve ser potência de 2
+
+#define SEM_WAIT_BUCKETS 16 // faixas do histograma: 0, 1, 2-3, 4-7, ... ms
+#define PRIORITY_LEVELS (MAX_PRIORITY - MIN_PRIORITY + 1)
+
+#define SHM_QUEUES_MAX 16 // filas compartilhadas abertas por processo
+#define MQUEUE_SHM_MAGIC 0x70706f73
+#define MQUEUE_GROW_MS 10 // espera com a fila cheia antes de ela crescer
+
 int last_task_id = 0;
 int last_semaphore_id = -1;
 int last_mqueue_id = -1;
 
 int can_preempt = 1;
 
+unsigned long context_switches = 0;
+
 task_t *main_task;
 task_t *dispatcher_task;
 task_t *current_task;
@@ -42,9 +63,12 @@ task_t **dispatcher_active_tasks;
 task_t **dispatcher_suspended_tasks;
 task_t **dispatcher_sleeping_tasks;
 
+task_t *dispatcher_timed_tasks = NULL; //ligadas por timed_prev/timed_next
+
 int active_tasks = 0;
 int suspended_tasks = 0;
 int sleeping_tasks = 0;
+int timed_tasks = 0;
 
 // estrutura que define um tratador de sinal (deve ser global ou static)
 struct sigaction action ;
@@ -54,177 +78,2056 @@ struct itimerval timer;
 
 disk_t *disk;
 
-// ========================== P13 ============================== 
+// funções internas usadas antes de serem definidas
+int sem_down_wait (semaphore_t *s, int timeout) ;
+int sem_up_n (semaphore_t *s, int n) ;
+unsigned int sem_hist_percentile(unsigned int *hist, unsigned int samples, int p) ;
+int mqueue_remaining(unsigned int deadline, int timeout) ;
+int mqueue_wait_error(int result, int timeout) ;
+void mqueue_copy_n(mqueue_t *queue, void *position, void *msgs, int count, int to_ring) ;
+void timed_wait_start(int ms, void (*cancel)(task_t *), void *obj) ;
+void timed_wait_stop(task_t *task) ;
+
+// tabela hash de filas de espera do ppos_wait, indexada pelo endereço
+task_t *futex_table[FUTEX_TABLE_SIZE];
+
+// ========================== Shared mqueue ============================== 
+
+// Filas entre processos: cabeçalho, estados das vagas e mensagens ficam num
+// segmento POSIX (shm_open/mmap), e reserve/peek devolvem ponteiros para ele.
+// Produtores e consumidores de processos diferentes disputam as posições com
+// o anel de Vyukov (cada vaga tem um seq que diz de quem é a vez), e dentro
+// do processo s_buffer/s_recv_buffer guardam a posição reservada até o
+// commit/release. A espera bloqueia só a tarefa (ppos_wait nos contadores
+// sends/recvs do segmento); o dispatcher observa esses contadores para
+// acordá-la quando o outro processo avança. Sem tarefa pronta, o dispatcher
+// dorme num futex do segmento (events), que o outro processo acorda a cada
+// commit/release; o tick do relógio também o interrompe.
+
+mqueue_t *shared_queues[SHM_QUEUES_MAX];
+int shm_waiting_tasks = 0;
+
+void *shm_slot(mqueue_t *queue, unsigned int pos) {
+    return queue->buffer + (pos % queue->max_msgs) * queue->msg_size;
+}
+
+int mqueue_open_shared (mqueue_t *queue, const char *name, int max, int size) {
+    int index, fd, creator = 1;
+    size_t header = sizeof(mqueue_shm_t) + max * sizeof(unsigned int);
+    size_t data_offset = (header + 15) & ~(size_t) 15;
+    size_t bytes = data_offset + (size_t) max * size;
+    struct stat st;
+    mqueue_shm_t *shm;
+
+    for (index = 0; index < SHM_QUEUES_MAX && shared_queues[index]; index++) ;
+
+    // posições sem limite, como nas filas MQUEUE_SPSC: max potência de 2
+    if (!(queue) || !(name) || max < 1 || (max & (max - 1)) || size < 1 || index == SHM_QUEUES_MAX) {
+        #ifdef DEBUG
+            perror("[ERRO] Parâmetros inválidos ou filas compartilhadas demais!\n");
+        #endif
+        return -1;
+    }
+
+    fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0 && errno == EEXIST) {
+        creator = 0;
+        fd = shm_open(name, O_RDWR, 0600);
+    }
+    if (fd < 0) {
+        #ifdef DEBUG
+            perror("[ERRO] shm_open falhou!\n");
+        #endif
+        return -1;
+    }
+
+    if (creator) {
+        if (ftruncate(fd, bytes) < 0) {
+            close(fd);
+            shm_unlink(name);
+            return -1;
+        }
+    } else {
+        // o criador pode ainda não ter dimensionado o segmento
+        for (int tries = 0; fstat(fd, &st) == 0 && st.st_size < (off_t) bytes; tries++) {
+            if (tries == 1000 || st.st_size > 0) { //tamanho diferente: outra fila
+                close(fd);
+                return -1;
+            }
+            task_sleep(1);
+        }
+    }
+
+    shm = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (shm == MAP_FAILED)
+        return -1;
+
+    if (creator) {
+        shm->max_msgs = max;
+        shm->msg_size = size;
+        shm->head = shm->tail = 0;
+        shm->sends = shm->recvs = 0;
+        shm->events = 0;
+        shm->sleepers = 0;
+        for (int i = 0; i < max; i++)
+            shm->seq[i] = i;
+        __atomic_store_n(&shm->magic, MQUEUE_SHM_MAGIC, __ATOMIC_RELEASE);
+    } else {
+        for (int tries = 0; __atomic_load_n(&shm->magic, __ATOMIC_ACQUIRE) != MQUEUE_SHM_MAGIC && tries < 1000; tries++)
+            task_sleep(1);
+        if (shm->magic != MQUEUE_SHM_MAGIC || shm->max_msgs != max || shm->msg_size != size) {
+            #ifdef DEBUG
+                perror("[ERRO] A fila compartilhada tem outro formato!\n");
+            #endif
+            munmap(shm, bytes);
+            return -1;
+        }
+    }
+
+    last_mqueue_id += 1;
+    queue->id = last_mqueue_id;
+    queue->buffer = (void *) shm + data_offset;
+    queue->max_msgs = max;
+    queue->msg_size = size;
+    queue->flags = MQUEUE_SHARED;
+    queue->overflow = MQUEUE_BLOCK;
+    queue->dropped = 0;
+    bzero(&queue->stats, sizeof(mqueue_stats_t));
+    queue->stamps = NULL;
+    queue->stamps_len = max;
+
+    queue->shm = shm;
+    queue->shm_bytes = bytes;
+    queue->shm_send_waiting = queue->shm_recv_waiting = 0;
+    queue->shm_sends_seen = shm->sends;
+    queue->shm_recvs_seen = shm->recvs;
+
+    queue->s_empty_lots = queue->s_items = NULL;
+    queue->s_buffer = malloc(sizeof(semaphore_t));
+    queue->s_recv_buffer = malloc(sizeof(semaphore_t));
+    sem_create(queue->s_buffer, 1);
+    sem_create(queue->s_recv_buffer, 1);
+
+    shared_queues[index] = queue;
+
+    #ifdef DEBUG
+        printf("[Mqueue Shared] Fila %d %s \"%s\"\n", queue->id, creator ? "criada como" : "ligada a", name);
+    #endif
+    return 0;
+}
 
-void disk_signal_handler() {
-    // wake up disk_task
+int mqueue_unlink_shared (const char *name) {
+    return shm_unlink(name) == 0 ? 0 : -1;
 }
 
-void suspend_disk_task() {
+// espera o contador do segmento sair de seen; timeout como em sem_down_wait
+int shm_wait(mqueue_t *queue, unsigned int *counter, unsigned int seen, int *waiting, int timeout) {
+    if (timeout == 0)
+        return PPOS_EAGAIN;
 
+    *waiting += 1;
+    shm_waiting_tasks += 1;
+    int result = ppos_wait_timed((int *) counter, (int) seen, timeout);
+    shm_waiting_tasks -= 1;
+    *waiting -= 1;
+
+    if (!(queue->shm))
+        return -1;
+    return result == PPOS_ETIMEDOUT ? PPOS_ETIMEDOUT : 0;
 }
 
-void suspend_disk_request_task() {
-    
+// a fila avançou (por outro processo) numa direção em que há tarefa local
+// esperando; só o dispatcher atualiza os contadores vistos
+int shm_moved(mqueue_t *queue, int update) {
+    unsigned int sends = __atomic_load_n(&queue->shm->sends, __ATOMIC_SEQ_CST);
+    unsigned int recvs = __atomic_load_n(&queue->shm->recvs, __ATOMIC_SEQ_CST);
+    int moved = 0;
+
+    if (queue->shm_recv_waiting && sends != queue->shm_sends_seen) {
+        moved = 1;
+        if (update) {
+            queue->shm_sends_seen = sends;
+            ppos_wake((int *) &queue->shm->sends, -1);
+        }
+    }
+    if (queue->shm_send_waiting && recvs != queue->shm_recvs_seen) {
+        moved = 1;
+        if (update) {
+            queue->shm_recvs_seen = recvs;
+            ppos_wake((int *) &queue->shm->recvs, -1);
+        }
+    }
+    return moved;
+}
+
+// chamada pelo dispatcher: acorda as tarefas locais cujas filas foram
+// movidas (por outro processo) desde a última verificação
+void check_shared_queues() {
+    if (shm_waiting_tasks == 0)
+        return;
+
+    for (int i = 0; i < SHM_QUEUES_MAX; i++)
+        if (shared_queues[i])
+            shm_moved(shared_queues[i], 1);
+}
+
+// chamada pelo dispatcher sem tarefas prontas: dorme no futex da primeira
+// fila com tarefas locais esperando até o outro processo avançá-la ou até um
+// sinal (tick, disco). Esperas em outras filas são vistas no próximo tick
+void shm_idle() {
+    mqueue_t *queue = NULL;
+
+    for (int i = 0; i < SHM_QUEUES_MAX && !(queue); i++)
+        if (shared_queues[i] && (shared_queues[i]->shm_send_waiting || shared_queues[i]->shm_recv_waiting))
+            queue = shared_queues[i];
+    if (!(queue))
+        return;
+
+    mqueue_shm_t *shm = queue->shm;
+    unsigned int events = __atomic_load_n(&shm->events, __ATOMIC_SEQ_CST);
+
+    // anuncia-se antes de reler os contadores: quem avançar depois disso vê
+    // sleepers e acorda; quem avançou antes é visto aqui
+    __atomic_add_fetch(&shm->sleepers, 1, __ATOMIC_SEQ_CST);
+    if (!shm_moved(queue, 0))
+        syscall(SYS_futex, &shm->events, FUTEX_WAIT, events, NULL, NULL, 0);
+    __atomic_sub_fetch(&shm->sleepers, 1, __ATOMIC_SEQ_CST);
+}
+
+// avisa o dispatcher de outro processo dormindo em shm_idle
+void shm_notify(mqueue_shm_t *shm) {
+    __atomic_add_fetch(&shm->events, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&shm->sleepers, __ATOMIC_SEQ_CST))
+        syscall(SYS_futex, &shm->events, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+// reserva uma vaga (ver mqueue_reserve_wait)
+int shm_reserve(mqueue_t *queue, void **slot, int timeout) {
+    unsigned int deadline = systime() + timeout;
+    int result;
+
+    if ((result = sem_down_wait(queue->s_buffer, timeout)) != 0)
+        return mqueue_wait_error(result, timeout);
+
+    for (;;) {
+        mqueue_shm_t *shm = queue->shm;
+        if (!(shm))
+            return -1;
+
+        unsigned int recvs = __atomic_load_n(&shm->recvs, __ATOMIC_ACQUIRE);
+        unsigned int pos = __atomic_load_n(&shm->tail, __ATOMIC_RELAXED);
+        int dif = (int) (__atomic_load_n(&shm->seq[pos % queue->max_msgs], __ATOMIC_ACQUIRE) - pos);
+
+        if (dif == 0) {
+            if (__atomic_compare_exchange_n(&shm->tail, &pos, pos + 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+                queue->shm_send_pos = pos;
+                *slot = shm_slot(queue, pos);
+                return 0;
+            }
+        } else if (dif < 0) { //cheia: espera algum recebimento
+            result = shm_wait(queue, &shm->recvs, recvs, &queue->shm_send_waiting, mqueue_remaining(deadline, timeout));
+            if (result != 0) {
+                if (queue->shm)
+                    sem_up(queue->s_buffer);
+                return mqueue_wait_error(result, timeout);
+            }
+        }
+        //dif > 0: outro processo pegou a posição; tenta a seguinte
+    }
+}
+
+// publica a vaga reservada por shm_reserve
+int shm_commit(mqueue_t *queue) {
+    mqueue_shm_t *shm = queue->shm;
+
+    __atomic_store_n(&shm->seq[queue->shm_send_pos % queue->max_msgs], queue->shm_send_pos + 1, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&shm->sends, 1, __ATOMIC_SEQ_CST);
+    shm_notify(shm);
+    if (queue->shm_recv_waiting)
+        ppos_wake((int *) &shm->sends, -1);
+
+    return sem_up(queue->s_buffer);
+}
+
+// obtém a mensagem mais antiga (ver mqueue_peek_wait)
+int shm_peek(mqueue_t *queue, void **slot, int timeout) {
+    unsigned int deadline = systime() + timeout;
+    int result;
+
+    if ((result = sem_down_wait(queue->s_recv_buffer, timeout)) != 0)
+        return mqueue_wait_error(result, timeout);
+
+    for (;;) {
+        mqueue_shm_t *shm = queue->shm;
+        if (!(shm))
+            return -1;
+
+        unsigned int sends = __atomic_load_n(&shm->sends, __ATOMIC_ACQUIRE);
+        unsigned int pos = __atomic_load_n(&shm->head, __ATOMIC_RELAXED);
+        int dif = (int) (__atomic_load_n(&shm->seq[pos % queue->max_msgs], __ATOMIC_ACQUIRE) - (pos + 1));
+
+        if (dif == 0) {
+            if (__atomic_compare_exchange_n(&shm->head, &pos, pos + 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+                queue->shm_recv_pos = pos;
+                *slot = shm_slot(queue, pos);
+                return 0;
+            }
+        } else if (dif < 0) { //vazia: espera algum envio
+            result = shm_wait(queue, &shm->sends, sends, &queue->shm_recv_waiting, mqueue_remaining(deadline, timeout));
+            if (result != 0) {
+                if (queue->shm)
+                    sem_up(queue->s_recv_buffer);
+                return mqueue_wait_error(result, timeout);
+            }
+        }
+    }
+}
+
+// devolve aos produtores a vaga obtida por shm_peek
+int shm_release(mqueue_t *queue) {
+    mqueue_shm_t *shm = queue->shm;
+
+    __atomic_store_n(&shm->seq[queue->shm_recv_pos % queue->max_msgs], queue->shm_recv_pos + queue->max_msgs, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&shm->recvs, 1, __ATOMIC_SEQ_CST);
+    shm_notify(shm);
+    if (queue->shm_send_waiting)
+        ppos_wake((int *) &shm->recvs, -1);
+
+    return sem_up(queue->s_recv_buffer);
+}
+
+// desfaz o mapeamento local; as tarefas locais que esperam retornam -1
+int shm_detach(mqueue_t *queue) {
+    for (int i = 0; i < SHM_QUEUES_MAX; i++)
+        if (shared_queues[i] == queue)
+            shared_queues[i] = NULL;
+
+    mqueue_shm_t *shm = queue->shm;
+    queue->shm = NULL;
+    queue->buffer = NULL;
+    ppos_wake((int *) &shm->sends, -1);
+    ppos_wake((int *) &shm->recvs, -1);
+    munmap(shm, queue->shm_bytes);
+
+    sem_destroy(queue->s_buffer);
+    sem_destroy(queue->s_recv_buffer);
+    queue->s_buffer = queue->s_recv_buffer = NULL;
+    return 0;
+}
+
+// ========================== Mqueue stats ============================== 
+
+// faixa do histograma de um valor: 0, 1, 2-3, 4-7, ...
+void mqueue_hist_add(unsigned int *hist, unsigned int value) {
+    int bucket = value ? 32 - __builtin_clz(value) : 0;
+
+    hist[bucket < MQUEUE_HIST_BUCKETS ? bucket : MQUEUE_HIST_BUCKETS - 1] += 1;
+}
+
+// registra uma espera que bloqueou desde start (produtor ou consumidor)
+void mqueue_stat_block(mqueue_t *queue, int sending, unsigned int start) {
+    if (!(queue->stamps)) //sem MQUEUE_STATS ou fila destruída
+        return;
+
+    unsigned int waited = systime() - start;
+    int old_can_preempt = can_preempt; //preserva o estado da preempção
+    can_preempt = 0;
+
+    if (sending) {
+        queue->stats.send_blocks++;
+        queue->stats.send_blocked_ms += waited;
+        mqueue_hist_add(queue->stats.send_wait_hist, waited);
+    } else {
+        queue->stats.recv_blocks++;
+        queue->stats.recv_blocked_ms += waited;
+        mqueue_hist_add(queue->stats.recv_wait_hist, waited);
+    }
+
+    can_preempt = old_can_preempt;
+}
+
+// registra o envio de count mensagens guardadas a partir de index (índice
+// em stamps); occupancy é a ocupação antes delas e é amostrada uma vez por
+// chamada
+void mqueue_stat_send(mqueue_t *queue, int index, int count, int occupancy) {
+    if (!(queue->stamps)) //sem MQUEUE_STATS ou fila destruída
+        return;
+
+    int old_can_preempt = can_preempt;
+    can_preempt = 0;
+
+    unsigned int now = systime();
+    for (int i = 0; i < count; i++) {
+        queue->stamps[index] = now;
+        if (++index == queue->stamps_len)
+            index = 0;
+    }
+
+    queue->stats.sends += count;
+    occupancy += count;
+    mqueue_hist_add(queue->stats.occupancy_hist, occupancy);
+    if (occupancy > queue->stats.high_water)
+        queue->stats.high_water = occupancy;
+
+    can_preempt = old_can_preempt;
+}
+
+// registra o recebimento de count mensagens guardadas a partir de index
+void mqueue_stat_recv(mqueue_t *queue, int index, int count) {
+    if (!(queue->stamps)) //sem MQUEUE_STATS ou fila destruída
+        return;
+
+    int old_can_preempt = can_preempt;
+    can_preempt = 0;
+
+    unsigned int now = systime();
+    for (int i = 0; i < count; i++) {
+        mqueue_hist_add(queue->stats.residence_hist, now - queue->stamps[index]);
+        if (++index == queue->stamps_len)
+            index = 0;
+    }
+    queue->stats.recvs += count;
+
+    can_preempt = old_can_preempt;
+}
+
+int mqueue_stats (mqueue_t *queue, mqueue_stats_t *stats) {
+    if (!(queue) || !(stats) || !(queue->flags & MQUEUE_STATS)) {
+        #ifdef DEBUG
+            perror("[ERRO] A fila não coleta estatísticas!\n");
+        #endif
+        return -1;
+    }
+
+    can_preempt = 0;
+    *stats = queue->stats;
+    can_preempt = 1;
+    return 0;
+}
+
+void mqueue_print_hist(char *label, unsigned int *hist) {
+    unsigned int samples = 0;
+
+    for (int bucket = 0; bucket < MQUEUE_HIST_BUCKETS; bucket++)
+        samples += hist[bucket];
+
+    if (samples == 0) {
+        printf("  %-18s -\n", label);
+        return;
+    }
+
+    printf("  %-18s p50 <= %u, p90 <= %u, p99 <= %u\n", label,
+        sem_hist_percentile(hist, samples, 50),
+        sem_hist_percentile(hist, samples, 90),
+        sem_hist_percentile(hist, samples, 99));
+}
+
+void mqueue_print_stats (mqueue_t *queue) {
+    mqueue_stats_t *st = &queue->stats;
+
+    if (!(queue->flags & MQUEUE_STATS)) {
+        #ifdef DEBUG
+            perror("[ERRO] A fila não coleta estatísticas!\n");
+        #endif
+        return;
+    }
+
+    // em MQUEUE_VARLEN max_msgs é o tamanho do anel, em bytes
+    if (queue->flags & MQUEUE_VARLEN)
+        printf("Mqueue %d: %lu sends, %lu recvs, %d dropped, high water %d messages in a %d-byte ring\n",
+            queue->id, st->sends, st->recvs, queue->dropped, st->high_water, queue->max_msgs);
+    else
+        printf("Mqueue %d: %lu sends, %lu recvs, %d dropped, high water %d of %d\n",
+            queue->id, st->sends, st->recvs, queue->dropped, st->high_water, queue->max_msgs);
+    printf("  producers blocked %u times, %lu ms total\n", st->send_blocks, st->send_blocked_ms);
+    printf("  consumers blocked %u times, %lu ms total\n", st->recv_blocks, st->recv_blocked_ms);
+    mqueue_print_hist("send blocked (ms)", st->send_wait_hist);
+    mqueue_print_hist("recv blocked (ms)", st->recv_wait_hist);
+    mqueue_print_hist("residence (ms)", st->residence_hist);
+    mqueue_print_hist("occupancy", st->occupancy_hist);
+}
+
+// ========================== Broadcast channels ============================== 
+
+// Um único anel com um cursor por assinante: a mensagem é copiada uma vez e
+// lida por todos. tail só cresce (a vaga é tail % max_msgs, com max_msgs
+// potência de 2 como nas filas MQUEUE_SPSC); assinantes sem
+// mensagem dormem em tail e o produtor bloqueado (CHANNEL_BLOCK) dorme em
+// reads, ambos com ppos_wait.
+
+int last_channel_id = -1;
+
+int channel_create (channel_t *channel, int max, int size, int policy) {
+    // tail e os cursores crescem sem limite: max potência de 2, como em
+    // MQUEUE_SPSC
+    if (!(channel) || max < 1 || (max & (max - 1)) || (policy == CHANNEL_LAP && max < 2)) {
+        #ifdef DEBUG
+            perror("[ERRO] Parâmetros inválidos para o canal!\n");
+        #endif
+        return -1;
+    }
+
+    last_channel_id += 1;
+    channel->id = last_channel_id;
+    channel->max_msgs = max;
+    channel->msg_size = size;
+    channel->policy = policy;
+    channel->buffer = malloc(max * size);
+    channel->tail = channel->reads = 0;
+    channel->recv_waiting = channel->send_waiting = 0;
+    channel->publishing = 0;
+    channel->subscribers = NULL;
+
+    channel->s_publish = malloc(sizeof(semaphore_t));
+    sem_create(channel->s_publish, 1);
+
+    #ifdef DEBUG
+        printf("[Channel Create] Canal %d com %d espaços de %d bytes\n", channel->id, max, size);
+    #endif
+    return 0;
+}
+
+int channel_subscribe (channel_t *channel, subscriber_t *sub) {
+    if (!(channel) || !(channel->buffer) || !(sub))
+        return -1;
+
+    can_preempt = 0;
+    sub->channel = channel;
+    sub->cursor = channel->tail;
+    sub->lost = 0;
+    sub->prev = sub->next = NULL;
+    queue_append((queue_t**) &channel->subscribers, (queue_t*) sub);
+    can_preempt = 1;
+
+    return 0;
+}
+
+// avisa o produtor bloqueado de que um cursor avançou
+void channel_notify_reader(channel_t *channel) {
+    __atomic_add_fetch(&channel->reads, 1, __ATOMIC_SEQ_CST);
+    if (channel->send_waiting)
+        ppos_wake((int *) &channel->reads, 1);
+}
+
+int channel_unsubscribe (subscriber_t *sub) {
+    channel_t *channel = sub ? sub->channel : NULL;
+
+    if (!(channel) || !(channel->buffer))
+        return -1;
+
+    can_preempt = 0;
+    queue_remove((queue_t**) &channel->subscribers, (queue_t*) sub);
+    sub->channel = NULL;
+    can_preempt = 1;
+
+    channel_notify_reader(channel); //pode ter sido o assinante mais lento
+    return 0;
+}
+
+// quantas mensagens o assinante mais atrasado ainda não leu
+unsigned int channel_backlog(channel_t *channel) {
+    unsigned int backlog = 0;
+
+    can_preempt = 0;
+    subscriber_t *sub = channel->subscribers;
+    int size = queue_size((queue_t*) sub);
+    for (int i = 0; i < size; i++, sub = sub->next) {
+        if (channel->tail - sub->cursor > backlog)
+            backlog = channel->tail - sub->cursor;
+    }
+    can_preempt = 1;
+
+    return backlog;
+}
+
+// sai de channel_publish; o último produtor a sair de um canal destruído
+// libera o semáforo, que channel_destroy não pôde liberar com ele em uso
+int channel_publish_leave (channel_t *channel, int result) {
+    if (__atomic_sub_fetch(&channel->publishing, 1, __ATOMIC_SEQ_CST) == 0 && !(channel->buffer) && channel->s_publish) {
+        free(channel->s_publish);
+        channel->s_publish = NULL;
+    }
+    return result;
+}
+
+int channel_publish (channel_t *channel, void *msg) {
+    if (!(channel) || !(channel->buffer))
+        return -1;
+
+    __atomic_add_fetch(&channel->publishing, 1, __ATOMIC_SEQ_CST);
+    if (sem_down(channel->s_publish) != 0) {
+        #ifdef DEBUG
+            perror("[ERRO] O canal não existe mais!\n");
+        #endif
+        return channel_publish_leave(channel, -1);
+    }
+
+    // CHANNEL_BLOCK: não sobrescreve mensagem que algum assinante não leu
+    while (channel->policy == CHANNEL_BLOCK && channel->buffer) {
+        unsigned int reads = channel->reads; //lido antes do teste de espaço
+
+        if (channel_backlog(channel) < (unsigned int) channel->max_msgs)
+            break;
+
+        channel->send_waiting = 1;
+        ppos_wait((int *) &channel->reads, (int) reads);
+        channel->send_waiting = 0;
+    }
+
+    if (!(channel->buffer)) //destruído durante a espera
+        return channel_publish_leave(channel, -1);
+
+    bcopy(msg, channel->buffer + (channel->tail % channel->max_msgs) * channel->msg_size, channel->msg_size);
+    __atomic_add_fetch(&channel->tail, 1, __ATOMIC_SEQ_CST);
+    if (channel->recv_waiting)
+        ppos_wake((int *) &channel->tail, -1);
+
+    #ifdef DEBUG
+        printf("[Channel Publish] Mensagem %u publicada no canal %d\n", channel->tail - 1, channel->id);
+    #endif
+
+    return channel_publish_leave(channel, sem_up(channel->s_publish));
+}
+
+int channel_recv (subscriber_t *sub, void *msg) {
+    channel_t *channel = sub ? sub->channel : NULL;
+    unsigned int tail;
+
+    if (!(channel))
+        return -1;
+
+    for (;;) {
+        if (!(channel->buffer)) {
+            #ifdef DEBUG
+                perror("[ERRO] O canal não existe mais!\n");
+            #endif
+            return -1;
+        }
+
+        tail = __atomic_load_n(&channel->tail, __ATOMIC_ACQUIRE);
+        if (tail == sub->cursor) {
+            __atomic_add_fetch(&channel->recv_waiting, 1, __ATOMIC_SEQ_CST);
+            ppos_wait((int *) &channel->tail, (int) tail);
+            __atomic_sub_fetch(&channel->recv_waiting, 1, __ATOMIC_SEQ_CST);
+            continue;
+        }
+
+        // CHANNEL_LAP: pula o que já foi (ou está sendo) sobrescrito
+        if (channel->policy == CHANNEL_LAP && tail - sub->cursor >= (unsigned int) channel->max_msgs) {
+            sub->lost += tail - sub->cursor - (channel->max_msgs - 1);
+            sub->cursor = tail - (channel->max_msgs - 1);
+        }
+
+        bcopy(channel->buffer + (sub->cursor % channel->max_msgs) * channel->msg_size, msg, channel->msg_size);
+
+        // a vaga pode ter sido sobrescrita durante a cópia: tenta de novo
+        if (channel->policy == CHANNEL_LAP && channel->tail - sub->cursor >= (unsigned int) channel->max_msgs)
+            continue;
+
+        sub->cursor++;
+        if (channel->policy == CHANNEL_BLOCK)
+            channel_notify_reader(channel);
+        return 0;
+    }
+}
+
+int channel_destroy (channel_t *channel) {
+    if (!(channel) || !(channel->buffer))
+        return -1;
+
+    can_preempt = 0;
+
+    #ifdef DEBUG
+        printf("[Channel Destroy] Destruindo canal %d\n", channel->id);
+    #endif
+    free(channel->buffer);
+    channel->buffer = NULL; //quem acordar vê o canal destruído
+    ppos_wake((int *) &channel->tail, -1);
+    ppos_wake((int *) &channel->reads, -1);
+
+    sem_destroy(channel->s_publish);
+    if (channel->publishing == 0) {
+        free(channel->s_publish);
+        channel->s_publish = NULL;
+    }
+    channel->subscribers = NULL;
+
+    can_preempt = 1;
+    return 0;
+}
+
+// ========================== Wait any ============================== 
+
+// semáforo por trás do objeto monitorado
+semaphore_t *waitobj_sem(waitobj_t *obj) {
+    if (obj->type == WAITOBJ_MQUEUE)
+        return ((mqueue_t *) obj->object)->s_items;
+    return (semaphore_t *) obj->object;
+}
+
+// retorna o índice do primeiro objeto pronto, ou -1 se nenhum estiver;
+// objetos destruídos contam como prontos, para a operação reportar o erro
+int wait_any_ready(waitobj_t *objs, int n) {
+    for (int i = 0; i < n; i++) {
+        semaphore_t *s = waitobj_sem(&objs[i]);
+        if (!(s) || !(s->suspended_tasks) || s->counter > 0)
+            return i;
+    }
+    return -1;
+}
+
+// acorda as tarefas em ppos_wait_any sobre o semáforo; elas mesmas retiram
+// seus registros dos semáforos quando voltam a executar
+void sem_wake_pollers(semaphore_t *s) {
+    poller_t *poller = s->pollers;
+    int size = queue_size((queue_t*) s->pollers);
+
+    for (int i = 0; i < size; i++) {
+        task_t *task = poller->task;
+
+        // a tarefa pode já ter sido acordada por outro objeto
+        if (task->status == TASK_SUSPENDED && task->wait_ready < 0) {
+            #ifdef DEBUG
+                printf("[Wait Any] semáforo %d acordando a tarefa de id %d\n", s->id, task->id);
+            #endif
+            task->wait_ready = poller->index;
+            timed_wait_stop(task);
+
+            queue_append((queue_t**) dispatcher_active_tasks, (queue_t*) task);
+            active_tasks += 1;
+            task->status = TASK_RUNNING;
+        }
+
+        poller = poller->next;
+    }
+}
+
+int ppos_wait_any (waitobj_t *objs, int n, int ms) {
+    if (!(objs) || n <= 0) {
+        #ifdef DEBUG
+            perror("[ERRO] Não há objetos para esperar!\n");
+        #endif
+        return -1;
+    }
+
+    for (int i = 0; i < n; i++) {
+        if (objs[i].type == WAITOBJ_MQUEUE && (((mqueue_t *) objs[i].object)->flags & (MQUEUE_SPSC | MQUEUE_SHARED))) {
+            #ifdef DEBUG
+                perror("[ERRO] Filas SPSC e compartilhadas não têm semáforos para esperar!\n");
+            #endif
+            return -1;
+        }
+    }
+
+    can_preempt = 0;
+
+    int ready = wait_any_ready(objs, n);
+    if (ready >= 0 || ms == 0) {
+        can_preempt = 1;
+        return ready >= 0 ? ready : PPOS_EAGAIN;
+    }
+
+    task_t *self = current_task;
+    poller_t *pollers = malloc(n * sizeof(poller_t));
+
+    for (int i = 0; i < n; i++) {
+        pollers[i].prev = pollers[i].next = NULL;
+        pollers[i].sem = waitobj_sem(&objs[i]);
+        pollers[i].task = self;
+        pollers[i].index = i;
+        queue_append((queue_t**) &pollers[i].sem->pollers, (queue_t*) &pollers[i]);
+    }
+
+    #ifdef DEBUG
+        printf("[Wait Any] tarefa de id %d esperando em %d objetos\n", self->id, n);
+    #endif
+    queue_remove((queue_t**) dispatcher_active_tasks, (queue_t*) self); //remove da lista de tarefas
+    active_tasks -= 1;
+
+    self->status = TASK_SUSPENDED;
+    self->wait_ready = -1;
+    self->wait_result = 0;
+
+    // nada a desfazer no prazo: os registros saem dos semáforos no retorno
+    if (ms > 0)
+        timed_wait_start(ms, NULL, NULL);
+
+    can_preempt = 1;
+    task_yield();
+    can_preempt = 0;
+
+    // sai das filas dos semáforos que não foram destruídos nesse meio tempo
+    for (int i = 0; i < n; i++) {
+        if (pollers[i].next)
+            queue_remove((queue_t**) &pollers[i].sem->pollers, (queue_t*) &pollers[i]);
+    }
+    free(pollers);
+
+    ready = self->wait_result == PPOS_ETIMEDOUT ? PPOS_ETIMEDOUT : self->wait_ready;
+    self->wait_ready = -1;
+
+    can_preempt = 1;
+    return ready;
+}
+
+// ========================== Timed waits ============================== 
+
+// retira a tarefa de uma fila circular de tarefas em O(1) (queue_remove
+// percorre a fila para validar o elemento)
+void task_queue_unlink(task_t **queue, task_t *task) {
+    if (task->next == task) {
+        (*queue) = NULL;
+    } else {
+        if ((*queue) == task)
+            (*queue) = task->next;
+        task->prev->next = task->next;
+        task->next->prev = task->prev;
+    }
+
+    task->next = NULL;
+    task->prev = NULL;
+}
+
+// registra um prazo para a espera da tarefa corrente; ao expirar, cancel
+// (se houver) retira a tarefa da fila de espera do objeto obj
+void timed_wait_start(int ms, void (*cancel)(task_t *), void *obj) {
+    task_t *self = current_task;
+
+    self->deadline = systime() + ms;
+    self->wait_cancel = cancel;
+    self->wait_obj = obj;
+    self->wait_result = 0;
+
+    self->timed_prev = NULL;
+    self->timed_next = dispatcher_timed_tasks;
+    if (dispatcher_timed_tasks)
+        dispatcher_timed_tasks->timed_prev = self;
+    dispatcher_timed_tasks = self;
+    timed_tasks += 1;
+}
+
+// remove a tarefa da lista de esperas com prazo (acordou antes do prazo)
+void timed_wait_stop(task_t *task) {
+    if (!(task->timed_prev) && dispatcher_timed_tasks != task)
+        return;
+
+    if (task->timed_prev)
+        task->timed_prev->timed_next = task->timed_next;
+    else
+        dispatcher_timed_tasks = task->timed_next;
+    if (task->timed_next)
+        task->timed_next->timed_prev = task->timed_prev;
+
+    task->timed_prev = task->timed_next = NULL;
+    task->wait_cancel = NULL;
+    task->wait_obj = NULL;
+    timed_tasks -= 1;
+}
+
+// acorda com PPOS_ETIMEDOUT as tarefas cujo prazo de espera expirou
+void check_timed_tasks() {
+    task_t *task = dispatcher_timed_tasks;
+
+    while (task) {
+        task_t *next_task = task->timed_next; //salva antes de remover da lista
+
+        if ((int) (systime() - task->deadline) >= 0) {
+            #ifdef DEBUG
+                printf("[Check Timed Tasks] prazo da tarefa de id %d expirou\n", task->id);
+            #endif
+            if (task->wait_cancel)
+                task->wait_cancel(task);
+            timed_wait_stop(task);
+
+            queue_append((queue_t**) dispatcher_active_tasks, (queue_t*) task);
+            active_tasks += 1;
+            task->status = TASK_RUNNING;
+            task->wait_result = PPOS_ETIMEDOUT;
+        }
+
+        task = next_task;
+    }
+}
+
+// ========================== Futex ============================== 
+
+// espalha endereços (alinhados em 4 bytes) pelas filas da tabela
+int futex_hash(int *addr) {
+    unsigned long key = (unsigned long) addr >> 2;
+    return (int) ((key * 2654435761UL) >> 7) & (FUTEX_TABLE_SIZE - 1);
+}
+
+// retira do balde do futex a tarefa cujo prazo expirou
+void futex_cancel_wait(task_t *task) {
+    task_queue_unlink(&futex_table[futex_hash(task->futex_addr)], task);
+    task->futex_addr = NULL;
+}
+
+// suspende a tarefa corrente se *addr == expected, por no máximo ms
+// milissegundos (ms < 0: sem prazo)
+int ppos_wait_timed (int *addr, int expected, int ms) {
+    if (!(addr)) {
+        #ifdef DEBUG
+            perror("[ERRO] O endereço não existe!\n");
+        #endif
+        return -1;
+    }
+
+    can_preempt = 0;
+
+    // o teste e a suspensão são atômicos em relação ao ppos_wake
+    if (*addr != expected) {
+        can_preempt = 1;
+        return -1;
+    }
+
+    task_t *self = current_task;
+    task_t **bucket = &futex_table[futex_hash(addr)];
+
+    #ifdef DEBUG
+        printf("[Futex Wait] movendo a tarefa de id %d para a fila %d da tabela\n", self->id, futex_hash(addr));
+    #endif
+    queue_remove((queue_t**) dispatcher_active_tasks, (queue_t*) self); //remove da lista de tarefas
+    active_tasks -= 1;
+
+    queue_append((queue_t**) bucket, (queue_t*) self);
+    self->futex_addr = addr;
+    self->status = TASK_SUSPENDED;
+    self->wait_result = 0;
+
+    if (ms >= 0)
+        timed_wait_start(ms, futex_cancel_wait, NULL);
+
+    can_preempt = 1;
+    task_yield();
+
+    return self->wait_result;
+}
+
+int ppos_wait (int *addr, int expected) {
+    return ppos_wait_timed(addr, expected, -1);
+}
+
+// acorda até n tarefas esperando em addr (n < 0: todas)
+int ppos_wake (int *addr, int n) {
+    int old_can_preempt = can_preempt; //preserva o estado da preempção
+    can_preempt = 0;
+
+    task_t **bucket = &futex_table[futex_hash(addr)];
+    task_t *task = *bucket;
+    int size = queue_size((queue_t*) *bucket);
+    int woken = 0;
+
+    // a fila pode conter tarefas de outros endereços com o mesmo hash
+    for (int i = 0; i < size && (n < 0 || woken < n); i++) {
+        task_t *next_task = task->next; //salva antes de remover da fila
+
+        if (task->futex_addr == addr) {
+            #ifdef DEBUG
+                printf("[Futex Wake] acordando a tarefa de id %d\n", task->id);
+            #endif
+            queue_remove((queue_t**) bucket, (queue_t*) task);
+            queue_append((queue_t**) dispatcher_active_tasks, (queue_t*) task);
+            active_tasks += 1;
+
+            task->status = TASK_RUNNING;
+            task->futex_addr = NULL;
+            timed_wait_stop(task);
+            woken++;
+        }
+
+        task = next_task;
+    }
+
+    can_preempt = old_can_preempt;
+
+    return woken;
+}
+
+// ========================== P13 ============================== 
+
+// tira a tarefa corrente da fila de prontas; chamada com can_preempt = 0
+void suspend_disk_current_task() {
+    task_t *self = current_task;
+
+    queue_remove((queue_t**) dispatcher_active_tasks, (queue_t*) self); //remove da lista de tarefas
+    active_tasks -= 1;
+    self->status = TASK_SUSPENDED;
+
+    can_preempt = 1;
+    task_yield();
+}
+
+// o gerente de disco dorme até o dispatcher ver um sinal do disco
+void suspend_disk_task() {
+    #ifdef DEBUG
+        printf("[Disk] gerente de disco dormindo\n");
+    #endif
+    suspend_disk_current_task();
+}
+
+// acorda o gerente de disco se o tratador do SIGUSR1 deixou entregas
+void check_disk() {
+    if (!(disk->signaled) || disk_task->status != TASK_SUSPENDED)
+        return;
+
+    disk->signaled = 0;
+    queue_append((queue_t**) dispatcher_active_tasks, (queue_t*) disk_task);
+    active_tasks += 1;
+    disk_task->status = TASK_RUNNING;
+}
+
+// ========================== SPSC mqueue ============================== 
+
+// Filas MQUEUE_SPSC: o produtor só escreve spsc_tail e o consumidor só escreve
+// spsc_head, então o anel dispensa semáforos. Os índices crescem sem limite
+// (a vaga é índice % max_msgs, max_msgs potência de 2 para a conta resistir à
+// volta em 2^32) e são publicados com ordem de memória
+// acquire/release, o que mantém a fila correta mesmo com tarefas em núcleos
+// diferentes. Cada lado só dorme (em ppos_wait) com o anel vazio ou cheio.
+
+void *spsc_slot(mqueue_t *queue, unsigned int index) {
+    return queue->buffer + (index % queue->max_msgs) * queue->msg_size;
+}
+
+int spsc_count(mqueue_t *queue) {
+    return __atomic_load_n(&queue->spsc_tail, __ATOMIC_ACQUIRE) - __atomic_load_n(&queue->spsc_head, __ATOMIC_ACQUIRE);
+}
+
+// espera o índice do outro lado sair do valor stale; timeout como em
+// sem_down_wait
+int spsc_wait(mqueue_t *queue, unsigned int *index, unsigned int stale, int *waiting, int timeout) {
+    unsigned int deadline = systime() + timeout;
+
+    while (__atomic_load_n(index, __ATOMIC_ACQUIRE) == stale) {
+        if (!(queue->buffer))
+            return -1;
+
+        int remaining = mqueue_remaining(deadline, timeout);
+        if (remaining == 0)
+            return timeout == 0 ? PPOS_EAGAIN : PPOS_ETIMEDOUT;
+
+        // o sinalizador é publicado antes de reler o índice (em ppos_wait),
+        // e o outro lado publica o índice antes de ler o sinalizador
+        __atomic_store_n(waiting, 1, __ATOMIC_SEQ_CST);
+        ppos_wait_timed((int *) index, (int) stale, remaining);
+        __atomic_store_n(waiting, 0, __ATOMIC_SEQ_CST);
+    }
+
+    return queue->buffer ? 0 : -1;
+}
+
+// avança o próprio índice em count e acorda o outro lado, se estiver dormindo
+void spsc_publish(unsigned int *index, int count, int *waiting) {
+    __atomic_store_n(index, *index + count, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(waiting, __ATOMIC_SEQ_CST))
+        ppos_wake((int *) index, 1);
+}
+
+// espera uma vaga livre no anel e a devolve em slot
+int spsc_reserve(mqueue_t *queue, void **slot, int timeout) {
+    unsigned int tail = queue->spsc_tail;
+    unsigned int start = systime();
+    int full = timeout != 0 && queue->spsc_head == tail - queue->max_msgs;
+    int result = spsc_wait(queue, &queue->spsc_head, tail - queue->max_msgs, &queue->spsc_send_waiting, timeout);
+
+    if (full && queue->buffer)
+        mqueue_stat_block(queue, 1, start);
+
+    if (result == 0)
+        *slot = spsc_slot(queue, tail);
+    return result;
+}
+
+// espera uma mensagem no anel e a devolve em slot
+int spsc_peek(mqueue_t *queue, void **slot, int timeout) {
+    unsigned int head = queue->spsc_head;
+    unsigned int start = systime();
+    int empty = timeout != 0 && queue->spsc_tail == head;
+    int result = spsc_wait(queue, &queue->spsc_tail, head, &queue->spsc_recv_waiting, timeout);
+
+    if (empty && queue->buffer)
+        mqueue_stat_block(queue, 0, start);
+
+    if (result == 0)
+        *slot = spsc_slot(queue, head);
+    return result;
+}
+
+// ========================== P12 ============================== 
+
+// cria uma fila para até max mensagens de size bytes cada
+int mqueue_create (mqueue_t *queue, int max, int size) {
+    return mqueue_create_flags(queue, max, size, 0);
+}
+
+// cria uma fila com as opções indicadas
+int mqueue_create_flags (mqueue_t *queue, int max, int size, int flags) {
+
+    #ifdef DEBUG
+        printf("[Mqueue Create] Criando fila de mensagens com ID %d, %d espaços de %d bytes\n", last_mqueue_id+1, max, size);
+    #endif
+
+    if (!(queue)) {
+        return 1;
+    }
+
+    // os modos de fila são exclusivos entre si
+    if (__builtin_popcount(flags & (MQUEUE_SPSC | MQUEUE_VARLEN | MQUEUE_PRIO)) > 1 || (flags & MQUEUE_SHARED)) {
+        #ifdef DEBUG
+            perror("[ERRO] MQUEUE_SPSC, MQUEUE_VARLEN e MQUEUE_PRIO não se combinam, e MQUEUE_SHARED é só de mqueue_open_shared!\n");
+        #endif
+        return -1;
+    }
+
+    // os índices do anel SPSC crescem sem limite; com max potência de 2,
+    // índice % max continua certo quando o contador dá a volta em 2^32
+    if ((flags & MQUEUE_SPSC) && (max < 1 || (max & (max - 1)))) {
+        #ifdef DEBUG
+            perror("[ERRO] Filas MQUEUE_SPSC precisam de max potência de 2!\n");
+        #endif
+        return -1;
+    }
+
+    // uma mensagem do tamanho máximo precisa caber no anel
+    if ((flags & MQUEUE_VARLEN) && (size < 0 || size + (int) sizeof(int) > max)) {
+        #ifdef DEBUG
+            perror("[ERRO] A fila não comporta uma mensagem do tamanho máximo!\n");
+        #endif
+        return -1;
+    }
+    
+    last_mqueue_id += 1;
+    queue->id = last_mqueue_id;
+    
+    queue->buffer = malloc((flags & MQUEUE_VARLEN) ? max : max * size);
+    queue->max_msgs = max;
+    queue->msg_size = size;
+    queue->current_item = queue->buffer;
+    queue->next_position = queue->buffer;
+    queue->flags = flags;
+    queue->overflow = MQUEUE_BLOCK;
+    queue->dropped = 0;
+    queue->resize_min = queue->resize_max = 0;
+    queue->ring_used = 0;
+
+    // filas MQUEUE_VARLEN guardam no máximo um registro a cada sizeof(int)
+    // bytes; as demais, uma mensagem por vaga
+    bzero(&queue->stats, sizeof(mqueue_stats_t));
+    queue->stamps_len = (flags & MQUEUE_VARLEN) ? max / (int) sizeof(int) : max;
+    queue->stamps = (flags & MQUEUE_STATS) ? malloc(queue->stamps_len * sizeof(unsigned int)) : NULL;
+
+    if (flags & MQUEUE_SPSC) {
+        queue->spsc_head = queue->spsc_tail = 0;
+        queue->spsc_recv_waiting = queue->spsc_send_waiting = 0;
+        queue->s_empty_lots = queue->s_buffer = NULL;
+        queue->s_recv_buffer = queue->s_items = NULL;
+        return 0;
+    }
+
+    if (flags & MQUEUE_PRIO) {
+        // cada nível pode chegar a ter todas as vagas da fila
+        queue->prio_ring = malloc(MQUEUE_PRIO_LEVELS * max * sizeof(int));
+        queue->prio_free = malloc(max * sizeof(int));
+        for (int i = 0; i < max; i++)
+            queue->prio_free[i] = max - 1 - i;
+        queue->prio_nfree = max;
+        for (int i = 0; i < MQUEUE_PRIO_LEVELS; i++)
+            queue->prio_head[i] = queue->prio_count[i] = 0;
+        queue->prio_mask = 0;
+        queue->send_prio = MQUEUE_PRIO_LEVELS - 1;
+    }
+
+    if (flags & MQUEUE_VARLEN) {
+        // o espaço livre é contado em bytes em var_free, não em vagas
+        queue->var_free = max;
+        queue->s_empty_lots = NULL;
+    } else {
+        queue->s_empty_lots = malloc(sizeof(semaphore_t));
+        sem_create(queue->s_empty_lots, max);
+    }
+
+    queue->s_buffer = malloc(sizeof(semaphore_t));
+    queue->s_recv_buffer = malloc(sizeof(semaphore_t));
+    queue->s_items = malloc(sizeof(semaphore_t));
+    sem_create(queue->s_buffer, 1);
+    sem_create(queue->s_recv_buffer, 1);
+    sem_create(queue->s_items, 0);
+
+    return 0;
+}
+
+// tempo que resta até deadline para a próxima espera de uma operação na fila
+// (mantém timeout < 0 como espera indefinida e 0 como não-bloqueante)
+int mqueue_remaining(unsigned int deadline, int timeout) {
+    if (timeout <= 0)
+        return timeout;
+
+    int remaining = (int) (deadline - systime());
+    return remaining > 0 ? remaining : 0;
+}
+
+// converte o retorno de sem_down_wait no erro da operação na fila
+int mqueue_wait_error(int result, int timeout) {
+    if (result == PPOS_EAGAIN && timeout > 0) //o prazo acabou entre as esperas
+        return PPOS_ETIMEDOUT;
+    if (result < 0)
+        return result;
+    return -1; //semáforo destruído
+}
+
+// avança uma posição no anel, voltando ao início no fim do buffer
+void *mqueue_advance(mqueue_t *queue, void *position) {
+    if (position + queue->msg_size == (queue->buffer + queue->max_msgs * queue->msg_size)) { //ou seja, estouraria o buffer
+        return queue->buffer;
+    }
+    return position + queue->msg_size;
+}
+
+// Filas MQUEUE_PRIO: as vagas ficam numa pilha de livres e cada nível de
+// urgência tem seu anel de índices de vagas ocupadas; prio_mask diz quais
+// níveis têm mensagens, então todas as operações são O(1). Produtores e
+// consumidores mexem nas mesmas estruturas, daí as seções sem preempção.
+
+// retira uma vaga da pilha de livres (o produtor já tem s_empty_lots)
+void *mqueue_prio_take_free(mqueue_t *queue) {
+    int old_can_preempt = can_preempt; //preserva o estado da preempção
+    can_preempt = 0;
+    int index = queue->prio_free[--queue->prio_nfree];
+    can_preempt = old_can_preempt;
+
+    return queue->buffer + index * queue->msg_size;
+}
+
+// põe a vaga preenchida no fim do anel do nível send_prio
+void mqueue_prio_put(mqueue_t *queue, void *slot) {
+    int level = queue->send_prio;
+    int *ring = queue->prio_ring + level * queue->max_msgs;
+
+    int old_can_preempt = can_preempt;
+    can_preempt = 0;
+    ring[(queue->prio_head[level] + queue->prio_count[level]) % queue->max_msgs] = (slot - queue->buffer) / queue->msg_size;
+    queue->prio_count[level]++;
+    queue->prio_mask |= 1u << level;
+    can_preempt = old_can_preempt;
+
+    queue->send_prio = MQUEUE_PRIO_LEVELS - 1;
+}
+
+// vaga da mensagem mais antiga do nível mais urgente (o consumidor já tem
+// s_items); o nível fica em recv_level, pois outro mais urgente pode
+// chegar antes de mqueue_prio_drop
+void *mqueue_prio_first(mqueue_t *queue) {
+    int old_can_preempt = can_preempt;
+    can_preempt = 0;
+    int level = __builtin_ctz(queue->prio_mask);
+    int index = queue->prio_ring[level * queue->max_msgs + queue->prio_head[level]];
+    can_preempt = old_can_preempt;
+
+    queue->recv_level = level;
+    return queue->buffer + index * queue->msg_size;
+}
+
+// retira a mensagem obtida por mqueue_prio_first e devolve sua vaga
+void mqueue_prio_drop(mqueue_t *queue) {
+    int level = queue->recv_level;
+
+    int old_can_preempt = can_preempt;
+    can_preempt = 0;
+    queue->prio_head[level] = (queue->prio_head[level] + 1) % queue->max_msgs;
+    if (--queue->prio_count[level] == 0)
+        queue->prio_mask &= ~(1u << level);
+    queue->prio_free[queue->prio_nfree++] = (queue->current_item - queue->buffer) / queue->msg_size;
+    can_preempt = old_can_preempt;
+}
+
+int mqueue_set_overflow (mqueue_t *queue, int policy) {
+    int unsupported = (queue->flags & (MQUEUE_SPSC | MQUEUE_VARLEN | MQUEUE_SHARED)) ? policy != MQUEUE_BLOCK
+                    : (queue->flags & MQUEUE_PRIO) ? policy == MQUEUE_DROP_OLDEST : 0;
+
+    if (!(queue->buffer) || policy < MQUEUE_BLOCK || policy > MQUEUE_DROP_OLDEST || unsupported) {
+        #ifdef DEBUG
+            perror("[ERRO] Política inválida para esta fila!\n");
+        #endif
+        return -1;
+    }
+
+    queue->overflow = policy;
+    return 0;
+}
+
+int mqueue_dropped (mqueue_t *queue) {
+    return queue->dropped;
+}
+
+// MQUEUE_DROP_OLDEST: descarta as mensagens mais antigas até haver lots
+// vagas livres (ou a fila esvaziar). Se um consumidor está lendo (tem
+// s_recv_buffer), a mensagem mais antiga é a dele e o descarte fica com a nova.
+void mqueue_drop_oldest(mqueue_t *queue, int lots) {
+    can_preempt = 0;
+    while (queue->s_empty_lots->counter < lots && queue->s_items->counter > 0 && queue->s_recv_buffer->counter > 0) {
+        #ifdef DEBUG
+            printf("[Mqueue Send] Descartando a mensagem mais antiga da fila %d\n", queue->id);
+        #endif
+        queue->s_items->counter--;
+        queue->current_item = mqueue_advance(queue, queue->current_item);
+        queue->s_empty_lots->counter++;
+        queue->ring_used--;
+        queue->dropped++;
+    }
+    can_preempt = 1;
+}
+
+int mqueue_set_resize (mqueue_t *queue, int min_limit, int max_limit) {
+    if (!(queue->buffer) || (queue->flags & (MQUEUE_SPSC | MQUEUE_VARLEN | MQUEUE_PRIO | MQUEUE_SHARED))
+        || min_limit < 1 || min_limit > queue->max_msgs || max_limit < queue->max_msgs) {
+        #ifdef DEBUG
+            perror("[ERRO] Limites inválidos ou fila que não pode ser redimensionada!\n");
+        #endif
+        return -1;
+    }
+
+    queue->resize_min = min_limit;
+    queue->resize_max = max_limit;
+    queue->quiet_recvs = 0;
+    return 0;
+}
+
+// troca o anel por um de new_max vagas, copiando as mensagens em ordem para o
+// início (e os instantes de envio, com MQUEUE_STATS). Só é possível com as
+// exclusões mútuas livres: quem as tem pode estar com um ponteiro para uma
+// vaga do anel atual. Retorna a variação no número de vagas.
+int mqueue_resize(mqueue_t *queue, int new_max) {
+    int old_max = queue->max_msgs;
+    int used = queue->ring_used;
+    int first = (queue->current_item - queue->buffer) / queue->msg_size;
+
+    if (queue->s_buffer->counter < 1 || queue->s_recv_buffer->counter < 1 || used > new_max)
+        return 0;
+
+    void *buffer = malloc(new_max * queue->msg_size);
+    if (!(buffer))
+        return 0;
+
+    mqueue_copy_n(queue, queue->current_item, buffer, used, 0);
+    free(queue->buffer);
+
+    if (queue->stamps) {
+        unsigned int *stamps = malloc(new_max * sizeof(unsigned int));
+        for (int i = 0; i < used; i++)
+            stamps[i] = queue->stamps[(first + i) % old_max];
+        free(queue->stamps);
+        queue->stamps = stamps;
+        queue->stamps_len = new_max;
+    }
+
+    queue->buffer = buffer;
+    queue->max_msgs = new_max;
+    queue->current_item = buffer;
+    queue->next_position = buffer + (used % new_max) * queue->msg_size;
+    queue->quiet_recvs = 0;
+
+    #ifdef DEBUG
+        printf("[Mqueue Resize] Fila %d: %d -> %d vagas (%d mensagens)\n", queue->id, old_max, new_max, used);
+    #endif
+    return new_max - old_max;
+}
+
+// produtor esperou MQUEUE_GROW_MS com a fila cheia: dobra o anel, acordando
+// quem espera vaga
+void mqueue_grow(mqueue_t *queue) {
+    int new_max = queue->max_msgs * 2 < queue->resize_max ? queue->max_msgs * 2 : queue->resize_max;
+    int added = 0;
+
+    can_preempt = 0;
+    if (new_max > queue->max_msgs)
+        added = mqueue_resize(queue, new_max);
+    can_preempt = 1;
+
+    if (added > 0)
+        sem_up_n(queue->s_empty_lots, added);
+}
+
+// depois de um recebimento: com a fila ocupada até 1/4 por max_msgs
+// recebimentos seguidos, reduz o anel à metade, retirando vagas livres
+void mqueue_shrink(mqueue_t *queue) {
+    int new_max = queue->max_msgs / 2 > queue->resize_min ? queue->max_msgs / 2 : queue->resize_min;
+
+    can_preempt = 0;
+    if (queue->ring_used > queue->max_msgs / 4) {
+        queue->quiet_recvs = 0;
+    } else if (++queue->quiet_recvs >= queue->max_msgs && new_max < queue->max_msgs
+        && queue->s_empty_lots->counter >= queue->max_msgs - new_max) {
+        int removed = -mqueue_resize(queue, new_max);
+        queue->s_empty_lots->counter -= removed;
+    }
+    can_preempt = 1;
+}
+
+// espera uma vaga no anel; numa fila redimensionável, cada MQUEUE_GROW_MS de
+// espera com a fila cheia a faz dobrar, de modo que uma rajada que o
+// consumidor absorve logo não aumenta a fila
+int mqueue_lots_wait(mqueue_t *queue, int timeout) {
+    unsigned int deadline = systime() + timeout;
+    int result, remaining;
+
+    while (queue->buffer && queue->resize_max > queue->max_msgs && timeout != 0) {
+        remaining = mqueue_remaining(deadline, timeout);
+        if (remaining == 0)
+            return PPOS_ETIMEDOUT;
+
+        result = sem_down_wait(queue->s_empty_lots, remaining < 0 || remaining > MQUEUE_GROW_MS ? MQUEUE_GROW_MS : remaining);
+        if (result != PPOS_ETIMEDOUT && result != PPOS_EAGAIN)
+            return result;
+
+        if (queue->buffer)
+            mqueue_grow(queue);
+    }
+
+    return sem_down_wait(queue->s_empty_lots, mqueue_remaining(deadline, timeout));
+}
+
+// reserva a próxima vaga da fila para o produtor, que fica com a exclusão
+// mútua dos produtores até mqueue_send_commit; timeout como em sem_down_wait
+int mqueue_reserve_wait (mqueue_t *queue, void **slot, int timeout) {
+    unsigned int deadline = systime() + timeout;
+    int result;
+
+    if (queue->flags & MQUEUE_SPSC)
+        return spsc_reserve(queue, slot, timeout);
+
+    if (queue->flags & MQUEUE_SHARED)
+        return shm_reserve(queue, slot, timeout);
+
+    if (!(queue->buffer)) {
+        #ifdef DEBUG
+            perror("[ERRO] A fila não existe mais!\n");
+        #endif
+        return -1;
+    }
+
+    if (queue->flags & MQUEUE_VARLEN) {
+        #ifdef DEBUG
+            perror("[ERRO] Filas MQUEUE_VARLEN usam mqueue_send_var/mqueue_recv_var!\n");
+        #endif
+        return -1;
+    }
+
+    #ifdef DEBUG
+        printf("[Mqueue Send] Enviando mensagem para a fila de mensagens com ID %d com %d espaços\n", queue->id, queue->max_msgs);
+    #endif
+
+    // com descarte, a espera por vaga vira tentativa
+    int lot_timeout = queue->overflow == MQUEUE_BLOCK ? timeout : 0;
+
+    if (queue->overflow == MQUEUE_DROP_OLDEST)
+        mqueue_drop_oldest(queue, 1);
+
+    unsigned int start = systime();
+    int full = lot_timeout != 0 && queue->s_empty_lots->counter <= 0;
+
+    #ifdef DEBUG
+        printf("[Mqueue Send] Down no semáforo de vagas\n");
+    #endif
+    result = mqueue_lots_wait(queue, lot_timeout);
+    if (full && queue->buffer)
+        mqueue_stat_block(queue, 1, start);
+
+    if (result != 0) {
+        #ifdef DEBUG
+            perror("[ERRO] A fila não existe mais ou o prazo expirou!\n");
+        #endif
+        if (result == PPOS_EAGAIN && queue->overflow != MQUEUE_BLOCK) {
+            __atomic_add_fetch(&queue->dropped, 1, __ATOMIC_SEQ_CST);
+            return PPOS_EAGAIN;
+        }
+        return mqueue_wait_error(result, timeout);
+    }
+
+    #ifdef DEBUG
+        printf("[Mqueue Send] Down no semáforo do buffer\n");
+    #endif
+    if ((result = sem_down_wait(queue->s_buffer, mqueue_remaining(deadline, timeout))) != 0) {
+        #ifdef DEBUG
+            perror("[ERRO] A fila não existe mais ou o prazo expirou!\n");
+        #endif
+        sem_up(queue->s_empty_lots); //devolve a vaga reservada
+        return mqueue_wait_error(result, timeout);
+    }
+
+    if (queue->flags & MQUEUE_PRIO)
+        queue->next_position = mqueue_prio_take_free(queue);
+
+    *slot = queue->next_position;
+    return 0;
+}
+
+// entrega ao consumidor a vaga reservada por mqueue_reserve_wait
+int mqueue_send_commit (mqueue_t *queue) {
+    if (!(queue->buffer)) {
+        #ifdef DEBUG
+            perror("[ERRO] A fila não existe mais!\n");
+        #endif
+        return -1;
+    }
+
+    if (queue->flags & MQUEUE_SHARED)
+        return shm_commit(queue);
+
+    if (queue->flags & MQUEUE_SPSC) {
+        mqueue_stat_send(queue, queue->spsc_tail % queue->max_msgs, 1, spsc_count(queue));
+        spsc_publish(&queue->spsc_tail, 1, &queue->spsc_recv_waiting);
+        return 0;
+    }
+
+    mqueue_stat_send(queue, (queue->next_position - queue->buffer) / queue->msg_size, 1,
+        queue->s_items->counter > 0 ? queue->s_items->counter : 0);
+
+    if (queue->flags & MQUEUE_PRIO)
+        mqueue_prio_put(queue, queue->next_position);
+    else
+        queue->next_position = mqueue_advance(queue, queue->next_position);
+    __atomic_add_fetch(&queue->ring_used, 1, __ATOMIC_SEQ_CST);
+
+    #ifdef DEBUG
+        printf("[Mqueue Send] Up no semáforo do buffer\n");
+    #endif
+    if (sem_up(queue->s_buffer) == -1) {
+        #ifdef DEBUG
+            perror("[ERRO] A fila não existe mais!\n");
+        #endif
+        return -1;
+    }
+
+    #ifdef DEBUG
+        printf("[Mqueue Send] Up no semáforo de itens\n");
+    #endif
+    if (sem_up(queue->s_items) == -1) {
+        #ifdef DEBUG
+            perror("[ERRO] A fila não existe mais!\n");
+        #endif
+        return -1;
+    }
+
+    if (queue->s_empty_lots) //Queue is still alive
+        return 0;
+    return -1;
+}
+
+void *mqueue_send_reserve (mqueue_t *queue) {
+    void *slot;
+
+    if (mqueue_reserve_wait(queue, &slot, -1) != 0)
+        return NULL;
+    return slot;
+}
+
+// envia uma mensagem para a fila; timeout como em sem_down_wait
+int mqueue_send_wait (mqueue_t *queue, void *msg, int timeout) {
+    void *slot;
+    int result = mqueue_reserve_wait(queue, &slot, timeout);
+
+    if (result == PPOS_EAGAIN && queue->overflow != MQUEUE_BLOCK)
+        return 0; //descartada conforme a política
+
+    if (result != 0)
+        return result;
+
+    bcopy(msg, slot, queue->msg_size);
+    return mqueue_send_commit(queue);
+}
+
+// envia uma mensagem para a fila
+int mqueue_send (mqueue_t *queue, void *msg) {
+    return mqueue_send_wait(queue, msg, -1);
+}
+
+int mqueue_send_timed (mqueue_t *queue, void *msg, int ms) {
+    return mqueue_send_wait(queue, msg, ms > 0 ? ms : 0);
+}
+
+int mqueue_send_try (mqueue_t *queue, void *msg) {
+    return mqueue_send_wait(queue, msg, 0);
+}
+
+int mqueue_send_prio (mqueue_t *queue, void *msg, int prio) {
+    void *slot;
+    int result;
+
+    if (!(queue->flags & MQUEUE_PRIO) || prio < 0 || prio >= MQUEUE_PRIO_LEVELS) {
+        #ifdef DEBUG
+            perror("[ERRO] A fila não é MQUEUE_PRIO ou a prioridade é inválida!\n");
+        #endif
+        return -1;
+    }
+
+    result = mqueue_reserve_wait(queue, &slot, -1);
+
+    if (result == PPOS_EAGAIN && queue->overflow != MQUEUE_BLOCK)
+        return 0; //descartada conforme a política, como em mqueue_send_wait
+
+    if (result != 0)
+        return result;
+
+    bcopy(msg, slot, queue->msg_size);
+    queue->send_prio = prio; //protegido pela exclusão mútua dos produtores
+    return mqueue_send_commit(queue);
+}
+
+// obtém a mensagem mais antiga da fila sem retirá-la; o consumidor fica com a
+// exclusão mútua dos consumidores até mqueue_recv_release
+int mqueue_peek_wait (mqueue_t *queue, void **slot, int timeout) {
+    unsigned int deadline = systime() + timeout;
+    int result;
+
+    if (queue->flags & MQUEUE_SPSC)
+        return spsc_peek(queue, slot, timeout);
+
+    if (queue->flags & MQUEUE_SHARED)
+        return shm_peek(queue, slot, timeout);
+
+    if (!(queue->buffer)) {
+        #ifdef DEBUG
+            perror("[ERRO] A fila não existe mais!\n");
+        #endif
+        return -1;
+    }
+
+    if (queue->flags & MQUEUE_VARLEN) {
+        #ifdef DEBUG
+            perror("[ERRO] Filas MQUEUE_VARLEN usam mqueue_send_var/mqueue_recv_var!\n");
+        #endif
+        return -1;
+    }
+
+    #ifdef DEBUG
+        printf("[Mqueue Recv] Consumindo mensagem para a fila de mensagens com ID %d com %d espaços\n", queue->id, queue->max_msgs);
+    #endif
+
+    unsigned int start = systime();
+    int empty = timeout != 0 && queue->s_items->counter <= 0;
+
+    #ifdef DEBUG
+        printf("[Mqueue Recv] Down no semáforo de itens\n");
+    #endif
+    result = sem_down_wait(queue->s_items, timeout);
+    if (empty && queue->buffer)
+        mqueue_stat_block(queue, 0, start);
+
+    if (result != 0) {
+        #ifdef DEBUG
+            perror("[ERRO] A fila não existe mais ou o prazo expirou!\n");
+        #endif
+        return mqueue_wait_error(result, timeout);
+    }
+
+    #ifdef DEBUG
+        printf("[Mqueue Recv] Down no semáforo do buffer\n");
+    #endif
+    if ((result = sem_down_wait(queue->s_recv_buffer, mqueue_remaining(deadline, timeout))) != 0) {
+        #ifdef DEBUG
+            perror("[ERRO] A fila não existe mais ou o prazo expirou!\n");
+        #endif
+        sem_up(queue->s_items); //devolve a mensagem reservada
+        return mqueue_wait_error(result, timeout);
+    }
+
+    if (queue->flags & MQUEUE_PRIO)
+        queue->current_item = mqueue_prio_first(queue);
+
+    *slot = queue->current_item;
+    return 0;
+}
+
+// libera para os produtores a vaga obtida por mqueue_peek_wait
+int mqueue_recv_release (mqueue_t *queue) {
+    if (!(queue->buffer)) {
+        #ifdef DEBUG
+            perror("[ERRO] A fila não existe mais!\n");
+        #endif
+        return -1;
+    }
+
+    if (queue->flags & MQUEUE_SHARED)
+        return shm_release(queue);
+
+    if (queue->flags & MQUEUE_SPSC) {
+        mqueue_stat_recv(queue, queue->spsc_head % queue->max_msgs, 1);
+        spsc_publish(&queue->spsc_head, 1, &queue->spsc_send_waiting);
+        return 0;
+    }
+
+    mqueue_stat_recv(queue, (queue->current_item - queue->buffer) / queue->msg_size, 1);
+
+    if (queue->flags & MQUEUE_PRIO)
+        mqueue_prio_drop(queue);
+    else
+        queue->current_item = mqueue_advance(queue, queue->current_item);
+    __atomic_sub_fetch(&queue->ring_used, 1, __ATOMIC_SEQ_CST);
+
+    #ifdef DEBUG
+        printf("[Mqueue Recv] Up no semáforo do buffer\n");
+    #endif
+    if (sem_up(queue->s_recv_buffer) == -1) {
+        #ifdef DEBUG
+            perror("[ERRO] A fila não existe mais!\n");
+        #endif
+        return -1;
+    }
+
+    #ifdef DEBUG
+        printf("[Mqueue Recv] Up no semáforo de vagas\n");
+    #endif
+    if (sem_up(queue->s_empty_lots) == -1) {
+        #ifdef DEBUG
+            perror("[ERRO] A fila não existe mais!\n");
+        #endif
+        return -1;
+    }
+
+    if (queue->resize_max && queue->s_empty_lots)
+        mqueue_shrink(queue);
+
+    if (queue->s_empty_lots) //Queue is still alive
+        return 0;
+    return -1;
+}
+
+void *mqueue_recv_peek (mqueue_t *queue) {
+    void *slot;
+
+    if (mqueue_peek_wait(queue, &slot, -1) != 0)
+        return NULL;
+    return slot;
+}
+
+// recebe uma mensagem da fila; timeout como em sem_down_wait
+int mqueue_recv_wait (mqueue_t *queue, void *msg, int timeout) {
+    void *slot;
+    int result = mqueue_peek_wait(queue, &slot, timeout);
+
+    if (result != 0)
+        return result;
+
+    bcopy(slot, msg, queue->msg_size);
+    return mqueue_recv_release(queue);
+}
+
+// recebe uma mensagem da fila
+int mqueue_recv (mqueue_t *queue, void *msg) {
+    return mqueue_recv_wait(queue, msg, -1);
+}
+
+int mqueue_recv_timed (mqueue_t *queue, void *msg, int ms) {
+    return mqueue_recv_wait(queue, msg, ms > 0 ? ms : 0);
+}
+
+int mqueue_recv_try (mqueue_t *queue, void *msg) {
+    return mqueue_recv_wait(queue, msg, 0);
+}
+
+// reserva, além da vaga (ou mensagem) já obtida, até n - 1 outras que
+// estejam disponíveis sem bloquear; retorna o total reservado
+int mqueue_take_more(semaphore_t *s, int n) {
+    int more = n - 1;
+
+    can_preempt = 0;
+    if (more > s->counter)
+        more = s->counter > 0 ? s->counter : 0;
+    s->counter -= more;
+    can_preempt = 1;
+
+    return more + 1;
+}
+
+// copia count mensagens entre o anel (a partir de position) e o vetor msgs,
+// em até dois trechos contíguos por causa da volta no fim do buffer
+void mqueue_copy_n(mqueue_t *queue, void *position, void *msgs, int count, int to_ring) {
+    int index = (position - queue->buffer) / queue->msg_size;
+    int first = queue->max_msgs - index;
+
+    if (first > count)
+        first = count;
+
+    if (to_ring) {
+        memcpy(position, msgs, first * queue->msg_size);
+        memcpy(queue->buffer, msgs + first * queue->msg_size, (count - first) * queue->msg_size);
+    } else {
+        memcpy(msgs, position, first * queue->msg_size);
+        memcpy(msgs + first * queue->msg_size, queue->buffer, (count - first) * queue->msg_size);
+    }
 }
 
-void wake_up_disk_request_task(task_t* task) {
-    
+// posição count mensagens adiante no anel
+void *mqueue_advance_n(mqueue_t *queue, void *position, int count) {
+    int index = (position - queue->buffer) / queue->msg_size;
+    return queue->buffer + ((index + count) % queue->max_msgs) * queue->msg_size;
 }
 
-// ========================== P12 ============================== 
+int mqueue_send_n (mqueue_t *queue, void *msgs, int n) {
+    void *slot;
+    int result, count;
 
-// cria uma fila para até max mensagens de size bytes cada
-int mqueue_create (mqueue_t *queue, int max, int size) {
+    if (n <= 0)
+        return 0;
 
-    #ifdef DEBUG
-        printf("[Mqueue Create] Criando fila de mensagens com ID %d, %d espaços de %d bytes\n", last_mqueue_id+1, max, size);
-    #endif
+    if ((result = mqueue_reserve_wait(queue, &slot, -1)) != 0) {
+        if (result == PPOS_EAGAIN && queue->overflow != MQUEUE_BLOCK) {
+            __atomic_add_fetch(&queue->dropped, n - 1, __ATOMIC_SEQ_CST);
+            return 0;
+        }
+        return result;
+    }
 
-    if (!(queue)) {
-        return 1;
+    if (queue->flags & MQUEUE_SPSC) {
+        count = queue->max_msgs - spsc_count(queue);
+        count = count < n ? count : n;
+        mqueue_copy_n(queue, slot, msgs, count, 1);
+        mqueue_stat_send(queue, queue->spsc_tail % queue->max_msgs, count, spsc_count(queue));
+        spsc_publish(&queue->spsc_tail, count, &queue->spsc_recv_waiting);
+        return count;
     }
-    
-    last_mqueue_id += 1;
-    queue->id = last_mqueue_id;
-    
-    queue->buffer = malloc(max * size);
-    queue->max_msgs = max;
-    queue->msg_size = size;
-    queue->current_item = queue->buffer;
-    queue->next_position = queue->buffer;
 
-    queue->s_empty_lots = malloc(sizeof(semaphore_t));
-    queue->s_buffer = malloc(sizeof(semaphore_t));
-    queue->s_items = malloc(sizeof(semaphore_t));
-    sem_create(queue->s_empty_lots, max);
-    sem_create(queue->s_buffer, 1);
-    sem_create(queue->s_items, 0);
+    if (queue->flags & (MQUEUE_PRIO | MQUEUE_SHARED)) { //vagas não contíguas (ou de outro processo): uma por vez
+        bcopy(msgs, slot, queue->msg_size);
+        return mqueue_send_commit(queue) == 0 ? 1 : -1;
+    }
 
-    return 0;
-}
+    if (queue->overflow == MQUEUE_DROP_OLDEST) //uma antiga a menos por mensagem além da primeira
+        mqueue_drop_oldest(queue, n - 1);
 
-// envia uma mensagem para a fila
-int mqueue_send (mqueue_t *queue, void *msg) {
-    #ifdef DEBUG
-        printf("[Mqueue Send] Enviando mensagem para a fila de mensagens com ID %d com %d espaços\n", queue->id, queue->max_msgs);
-    #endif
+    count = mqueue_take_more(queue->s_empty_lots, n);
+    if (queue->overflow != MQUEUE_BLOCK)
+        __atomic_add_fetch(&queue->dropped, n - count, __ATOMIC_SEQ_CST);
+    if (queue->overflow == MQUEUE_DROP_OLDEST) //o lote maior que a fila perde o seu início
+        msgs += (n - count) * queue->msg_size;
+    mqueue_copy_n(queue, slot, msgs, count, 1);
+    mqueue_stat_send(queue, (slot - queue->buffer) / queue->msg_size, count,
+        queue->s_items->counter > 0 ? queue->s_items->counter : 0);
+    queue->next_position = mqueue_advance_n(queue, slot, count);
+    __atomic_add_fetch(&queue->ring_used, count, __ATOMIC_SEQ_CST);
 
     #ifdef DEBUG
-        printf("[Mqueue Send] Down no semáforo de vagas\n");
+        printf("[Mqueue Send N] %d mensagens enviadas para a fila %d\n", count, queue->id);
     #endif
-    if (sem_down(queue->s_buffer) == -1) {
+
+    if (sem_up(queue->s_buffer) == -1 || sem_up_n(queue->s_items, count) == -1) {
         #ifdef DEBUG
             perror("[ERRO] A fila não existe mais!\n");
         #endif
         return -1;
     }
 
+    return count;
+}
+
+int mqueue_recv_n (mqueue_t *queue, void *msgs, int n) {
+    void *slot;
+    int result, count;
+
+    if (n <= 0)
+        return 0;
+
+    if ((result = mqueue_peek_wait(queue, &slot, -1)) != 0)
+        return result;
+
+    if (queue->flags & MQUEUE_SPSC) {
+        count = spsc_count(queue);
+        count = count < n ? count : n;
+        mqueue_copy_n(queue, slot, msgs, count, 0);
+        mqueue_stat_recv(queue, queue->spsc_head % queue->max_msgs, count);
+        spsc_publish(&queue->spsc_head, count, &queue->spsc_send_waiting);
+        return count;
+    }
+
+    if (queue->flags & (MQUEUE_PRIO | MQUEUE_SHARED)) { //vagas não contíguas (ou de outro processo): uma por vez
+        bcopy(slot, msgs, queue->msg_size);
+        return mqueue_recv_release(queue) == 0 ? 1 : -1;
+    }
+
+    count = mqueue_take_more(queue->s_items, n);
+    mqueue_copy_n(queue, slot, msgs, count, 0);
+    mqueue_stat_recv(queue, (slot - queue->buffer) / queue->msg_size, count);
+    queue->current_item = mqueue_advance_n(queue, slot, count);
+    __atomic_sub_fetch(&queue->ring_used, count, __ATOMIC_SEQ_CST);
+
     #ifdef DEBUG
-        printf("[Mqueue Send] Down no semáforo do buffer\n");
+        printf("[Mqueue Recv N] %d mensagens recebidas da fila %d\n", count, queue->id);
     #endif
-    if (sem_up(queue->s_buffer) == -1) {
+
+    if (sem_up(queue->s_recv_buffer) == -1 || sem_up_n(queue->s_empty_lots, count) == -1) {
         #ifdef DEBUG
             perror("[ERRO] A fila não existe mais!\n");
         #endif
         return -1;
     }
 
-    if (queue->buffer) {
-        bcopy(msg, queue->next_position, queue->msg_size);
+    if (queue->resize_max && queue->s_empty_lots)
+        mqueue_shrink(queue);
 
-        if (queue->next_position + queue->msg_size == (queue->buffer + queue->max_msgs * queue->msg_size)) { //ou seja, estouraria o buffer
-            queue->next_position = queue->buffer;
-        } else {
-            queue->next_position += queue->msg_size;
-        }
+    return count;
+}
+
+// copia len bytes entre o anel de bytes (a partir de position) e data,
+// voltando ao início no fim do buffer; retorna a posição seguinte
+void *mqueue_var_copy(mqueue_t *queue, void *position, void *data, int len, int to_ring) {
+    int first = (queue->buffer + queue->max_msgs) - position;
+
+    if (first > len)
+        first = len;
+
+    if (to_ring) {
+        memcpy(position, data, first);
+        memcpy(queue->buffer, data + first, len - first);
+    } else {
+        memcpy(data, position, first);
+        memcpy(data + first, queue->buffer, len - first);
     }
 
-    #ifdef DEBUG
-        printf("[Mqueue Send] Up no semáforo do buffer\n");
-    #endif
-    if (sem_up(queue->s_buffer) == -1) {
+    if (first < len)
+        return queue->buffer + (len - first);
+    if (position + len == queue->buffer + queue->max_msgs)
+        return queue->buffer;
+    return position + len;
+}
+
+// espera haver need bytes livres no anel; só o produtor com a exclusão mútua
+// dos produtores espera aqui, então cada liberação acorda no máximo um
+int mqueue_var_space(mqueue_t *queue, int need, unsigned int deadline, int timeout) {
+    int free_bytes;
+
+    while ((free_bytes = queue->var_free) < need) {
+        if (!(queue->buffer))
+            return -1;
+
+        int remaining = mqueue_remaining(deadline, timeout);
+        if (remaining == 0)
+            return timeout == 0 ? PPOS_EAGAIN : PPOS_ETIMEDOUT;
+
+        ppos_wait_timed(&queue->var_free, free_bytes, remaining);
+    }
+
+    return queue->buffer ? 0 : -1;
+}
+
+// ajusta o espaço livre (consumidor libera, produtor ocupa)
+void mqueue_var_adjust(mqueue_t *queue, int delta) {
+    int old_can_preempt = can_preempt; //preserva o estado da preempção
+    can_preempt = 0;
+    queue->var_free += delta;
+    can_preempt = old_can_preempt;
+}
+
+// envia uma mensagem de tamanho variável; timeout como em sem_down_wait
+int mqueue_send_var_wait (mqueue_t *queue, void *msg, int len, int timeout) {
+    unsigned int deadline = systime() + timeout;
+    int need = len + sizeof(int);
+    int result;
+
+    if (!(queue->flags & MQUEUE_VARLEN) || len < 0 || len > queue->msg_size) {
         #ifdef DEBUG
-            perror("[ERRO] A fila não existe mais!\n");
+            perror("[ERRO] A fila não é MQUEUE_VARLEN ou a mensagem é grande demais!\n");
         #endif
         return -1;
     }
 
+    if ((result = sem_down_wait(queue->s_buffer, timeout)) != 0)
+        return mqueue_wait_error(result, timeout);
+
+    unsigned int start = systime();
+    int full = timeout != 0 && queue->var_free < need;
+
+    result = mqueue_var_space(queue, need, deadline, mqueue_remaining(deadline, timeout));
+    if (full && queue->buffer)
+        mqueue_stat_block(queue, 1, start);
+
+    if (result != 0) {
+        if (queue->buffer)
+            sem_up(queue->s_buffer);
+        return mqueue_wait_error(result, timeout);
+    }
+
     #ifdef DEBUG
-        printf("[Mqueue Send] Up no semáforo de itens\n");
+        printf("[Mqueue Send Var] %d bytes para a fila %d (%d livres)\n", len, queue->id, queue->var_free);
     #endif
-    if (sem_up(queue->s_items) == -1) {
+    mqueue_var_adjust(queue, -need);
+    queue->next_position = mqueue_var_copy(queue, queue->next_position, &len, sizeof(int), 1);
+    queue->next_position = mqueue_var_copy(queue, queue->next_position, msg, len, 1);
+    mqueue_stat_send(queue, queue->stats.sends % queue->stamps_len, 1,
+        queue->s_items->counter > 0 ? queue->s_items->counter : 0);
+
+    if (sem_up(queue->s_buffer) == -1 || sem_up(queue->s_items) == -1) {
         #ifdef DEBUG
             perror("[ERRO] A fila não existe mais!\n");
         #endif
         return -1;
     }
 
-    if (queue->s_empty_lots) //Queue is still alive
-        return 0;
-    return -1;
+    return 0;
 }
 
-// recebe uma mensagem da fila
-int mqueue_recv (mqueue_t *queue, void *msg) {
-    #ifdef DEBUG
-        printf("[Mqueue Recv] Consumindo mensagem para a fila de mensagens com ID %d com %d espaços\n", queue->id, queue->max_msgs);
-    #endif
+int mqueue_send_var (mqueue_t *queue, void *msg, int len) {
+    return mqueue_send_var_wait(queue, msg, len, -1);
+}
 
-    #ifdef DEBUG
-        printf("[Mqueue Recv] Down no semáforo de itens\n");
-    #endif
-    if (sem_down(queue->s_items) == -1) {
+// recebe uma mensagem de tamanho variável; timeout como em sem_down_wait
+int mqueue_recv_var_wait (mqueue_t *queue, void *msg, int timeout) {
+    unsigned int deadline = systime() + timeout;
+    int len, result;
+
+    if (!(queue->flags & MQUEUE_VARLEN)) {
         #ifdef DEBUG
-            perror("[ERRO] A fila não existe mais!\n");
+            perror("[ERRO] A fila não é MQUEUE_VARLEN!\n");
         #endif
         return -1;
     }
 
-    #ifdef DEBUG
-        printf("[Mqueue Recv] Down no semáforo do buffer\n");
-    #endif
-    if (sem_down(queue->s_buffer) == -1) {
+    if (!(queue->buffer)) {
         #ifdef DEBUG
             perror("[ERRO] A fila não existe mais!\n");
         #endif
         return -1;
     }
 
-    if (queue->buffer) {
-        bcopy(queue->current_item, msg, queue->msg_size);
+    unsigned int start = systime();
+    int empty = timeout != 0 && queue->s_items->counter <= 0;
 
-        if (queue->current_item + queue->msg_size == (queue->buffer + queue->max_msgs * queue->msg_size)) { //ou seja, estouraria o buffer
-            queue->current_item = queue->buffer;
-        } else {
-            queue->current_item += queue->msg_size;
-        }
-    }
+    result = sem_down_wait(queue->s_items, timeout);
+    if (empty && queue->buffer)
+        mqueue_stat_block(queue, 0, start);
 
-    #ifdef DEBUG
-        printf("[Mqueue Recv] Up no semáforo do buffer\n");
-    #endif
-    if (sem_up(queue->s_buffer) == -1) {
-        #ifdef DEBUG
-            perror("[ERRO] A fila não existe mais!\n");
-        #endif
-        return -1;
+    if (result != 0)
+        return mqueue_wait_error(result, timeout);
+
+    if ((result = sem_down_wait(queue->s_recv_buffer, mqueue_remaining(deadline, timeout))) != 0) {
+        sem_up(queue->s_items); //devolve a mensagem reservada
+        return mqueue_wait_error(result, timeout);
     }
 
+    queue->current_item = mqueue_var_copy(queue, queue->current_item, &len, sizeof(int), 0);
+    queue->current_item = mqueue_var_copy(queue, queue->current_item, msg, len, 0);
+    mqueue_stat_recv(queue, queue->stats.recvs % queue->stamps_len, 1);
+
     #ifdef DEBUG
-        printf("[Mqueue Recv] Up no semáforo de vagas\n");
+        printf("[Mqueue Recv Var] %d bytes da fila %d\n", len, queue->id);
     #endif
-    if (sem_up(queue->s_empty_lots) == -1) {
+
+    if (sem_up(queue->s_recv_buffer) == -1) {
         #ifdef DEBUG
             perror("[ERRO] A fila não existe mais!\n");
         #endif
         return -1;
     }
 
-    if (queue->s_empty_lots) //Queue is still alive
-        return 0;
-    return -1;
+    mqueue_var_adjust(queue, len + sizeof(int));
+    ppos_wake(&queue->var_free, 1);
 
+    return len;
+}
+
+int mqueue_recv_var (mqueue_t *queue, void *msg) {
+    return mqueue_recv_var_wait(queue, msg, -1);
 }
 
 // destroi a fila, liberando as tarefas bloqueadas
@@ -234,16 +2137,41 @@ int mqueue_destroy (mqueue_t *queue) {
         printf("[Mqueue Destroy] Destruindo fila de mensagens\n");
     #endif
 
+    if (queue->flags & MQUEUE_STATS)
+        mqueue_print_stats(queue);
+
     can_preempt = 0;
 
+    free(queue->stamps);
+    queue->stamps = NULL;
+
+    if (queue->flags & MQUEUE_SHARED) {
+        shm_detach(queue);
+        can_preempt = 1;
+        return 0;
+    }
+
+    if (queue->flags & MQUEUE_SPSC) {
+        // quem estiver esperando acorda, vê o buffer nulo e retorna erro
+        free(queue->buffer);
+        queue->buffer = NULL;
+        ppos_wake((int *) &queue->spsc_head, -1);
+        ppos_wake((int *) &queue->spsc_tail, -1);
+        can_preempt = 1;
+        return 0;
+    }
+
     #ifdef DEBUG
         printf("[Mqueue Destroy] Destruindo semáfotos\n");
     #endif
     sem_destroy(queue->s_buffer);
-    sem_destroy(queue->s_empty_lots);
+    sem_destroy(queue->s_recv_buffer);
+    if (queue->s_empty_lots)
+        sem_destroy(queue->s_empty_lots);
     sem_destroy(queue->s_items);
 
     queue->s_buffer = NULL;
+    queue->s_recv_buffer = NULL;
     queue->s_empty_lots = NULL;
     queue->s_items = NULL;
 
@@ -253,6 +2181,16 @@ int mqueue_destroy (mqueue_t *queue) {
     free(queue->buffer);
     queue->buffer = NULL;
 
+    if (queue->flags & MQUEUE_PRIO) {
+        free(queue->prio_ring);
+        free(queue->prio_free);
+        queue->prio_ring = queue->prio_free = NULL;
+    }
+
+    // produtor esperando espaço em fila MQUEUE_VARLEN vê o buffer nulo
+    if (queue->flags & MQUEUE_VARLEN)
+        ppos_wake(&queue->var_free, -1);
+
     can_preempt = 1;
 
     return 0;
@@ -260,6 +2198,10 @@ int mqueue_destroy (mqueue_t *queue) {
 
 // informa o número de mensagens atualmente na fila
 int mqueue_msgs (mqueue_t *queue) {
+    if (queue->flags & MQUEUE_SHARED)
+        return queue->shm->tail - queue->shm->head;
+    if (queue->flags & MQUEUE_SPSC)
+        return spsc_count(queue);
     return queue->s_items->counter;
 }
 
@@ -276,13 +2218,115 @@ int sem_create (semaphore_t *s, int value) {
 
     s->task_counter = 0;
     s->counter = value;
+    s->flags = 0;
+    s->heap = NULL;
+    s->heap_size = 0;
+    s->heap_capacity = 0;
+    s->heap_seq = 0;
+    s->wait_hist = NULL;
+    s->pollers = NULL;
     s->suspended_tasks = (task_t **)malloc(sizeof(task_t *));
     *(s->suspended_tasks) = NULL;
     return 0;
 }
 
-// requisita o semáforo
-int sem_down (semaphore_t *s) {
+// a tarefa a tem precedência sobre b no heap: maior prioridade (menor valor)
+// ou, em empate, quem chegou antes
+int sem_heap_before(task_t *a, task_t *b) {
+    if (a->wait_prio != b->wait_prio)
+        return a->wait_prio < b->wait_prio;
+    return a->wait_seq < b->wait_seq;
+}
+
+void sem_heap_swap(semaphore_t *s, int i, int j) {
+    task_t *aux = s->heap[i];
+    s->heap[i] = s->heap[j];
+    s->heap[j] = aux;
+    s->heap[i]->heap_index = i;
+    s->heap[j]->heap_index = j;
+}
+
+void sem_heap_sift_up(semaphore_t *s, int i) {
+    while (i > 0 && sem_heap_before(s->heap[i], s->heap[(i - 1) / 2])) {
+        sem_heap_swap(s, i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+}
+
+void sem_heap_sift_down(semaphore_t *s, int i) {
+    while (1) {
+        int left = 2 * i + 1, right = left + 1, best = i;
+        if (left < s->heap_size && sem_heap_before(s->heap[left], s->heap[best]))
+            best = left;
+        if (right < s->heap_size && sem_heap_before(s->heap[right], s->heap[best]))
+            best = right;
+        if (best == i)
+            break;
+        sem_heap_swap(s, i, best);
+        i = best;
+    }
+}
+
+// insere a tarefa no heap de espera, O(log n)
+void sem_heap_push(semaphore_t *s, task_t *task) {
+    if (s->heap_size == s->heap_capacity) {
+        s->heap_capacity = s->heap_capacity ? 2 * s->heap_capacity : 8;
+        s->heap = realloc(s->heap, s->heap_capacity * sizeof(task_t *));
+    }
+
+    // task_setprio pode mudar prio com a tarefa no heap; a ordem usa a cópia
+    task->wait_prio = task->prio;
+    task->wait_seq = s->heap_seq++;
+    task->heap_index = s->heap_size++;
+    s->heap[task->heap_index] = task;
+    sem_heap_sift_up(s, task->heap_index);
+}
+
+// retira do heap a tarefa na posição i, O(log n)
+task_t *sem_heap_remove(semaphore_t *s, int i) {
+    task_t *task = s->heap[i];
+
+    s->heap_size--;
+    if (i != s->heap_size) {
+        s->heap[i] = s->heap[s->heap_size];
+        s->heap[i]->heap_index = i;
+        sem_heap_sift_up(s, i);
+        sem_heap_sift_down(s, s->heap[i]->heap_index);
+    }
+
+    return task;
+}
+
+// contabiliza no histograma o tempo que a tarefa passou bloqueada
+void sem_record_wait(semaphore_t *s, task_t *task) {
+    unsigned int waited = systime() - task->wait_start;
+    int bucket = 0;
+
+    while (waited > 0 && bucket < SEM_WAIT_BUCKETS - 1) {
+        waited >>= 1;
+        bucket++;
+    }
+
+    s->wait_hist[(task->wait_prio - MIN_PRIORITY) * SEM_WAIT_BUCKETS + bucket] += 1;
+}
+
+// retira do semáforo uma tarefa cujo prazo de espera expirou
+void sem_cancel_wait(task_t *task) {
+    semaphore_t *s = task->wait_obj;
+
+    if (s->flags & SEM_PRIO)
+        sem_heap_remove(s, task->heap_index);
+    else
+        task_queue_unlink(s->suspended_tasks, task);
+
+    // desfaz o decremento feito pela tarefa no sem_down
+    s->task_counter -= 1;
+    s->counter += 1;
+}
+
+// requisita o semáforo; timeout < 0 espera indefinidamente, timeout == 0
+// nunca bloqueia e timeout > 0 espera no máximo timeout ms
+int sem_down_wait (semaphore_t *s, int timeout) {
     if (current_task->ticks < 0) {
         task_yield();
     }
@@ -303,6 +2347,11 @@ int sem_down (semaphore_t *s) {
         printf("[Semaphore Down] semaforo tem %d vagas e %d pessoas na fila\n", s->counter, s->task_counter);
     #endif
 
+    if (timeout == 0 && s->counter <= 0) {
+        can_preempt = 1;
+        return PPOS_EAGAIN;
+    }
+
     s->counter -= 1;
 
     if (s->counter < 0) {
@@ -317,14 +2366,25 @@ int sem_down (semaphore_t *s) {
         #endif
         
         s->task_counter += 1;
-        queue_append((queue_t**) s->suspended_tasks, (queue_t*) current_task);
+        if (s->flags & SEM_PRIO)
+            sem_heap_push(s, current_task);
+        else
+            queue_append((queue_t**) s->suspended_tasks, (queue_t*) current_task);
         current_task->status = TASK_SUSPENDED;
+        current_task->wait_start = systime();
+        current_task->wait_result = 0;
+
+        if (timeout > 0)
+            timed_wait_start(timeout, sem_cancel_wait, s);
 
         #ifdef DEBUG
             printf("[Semaphore Down] Reabilitando preempção em %d\n", current_task->id);
         #endif
         can_preempt = 1;
         task_yield();
+
+        if (current_task->wait_result == PPOS_ETIMEDOUT)
+            return PPOS_ETIMEDOUT;
     }
 
     #ifdef DEBUG
@@ -337,13 +2397,35 @@ int sem_down (semaphore_t *s) {
     return 1;
 }
 
-void sem_wake_up_first(semaphore_t *s) {
-    task_t * task = *(s->suspended_tasks);
+// requisita o semáforo
+int sem_down (semaphore_t *s) {
+    return sem_down_wait(s, -1);
+}
+
+// requisita o semáforo, esperando no máximo ms milissegundos
+int sem_down_timed (semaphore_t *s, int ms) {
+    return sem_down_wait(s, ms > 0 ? ms : 0);
+}
+
+// requisita o semáforo somente se isso não bloquear a tarefa
+int sem_down_try (semaphore_t *s) {
+    return sem_down_wait(s, 0);
+}
+
+task_t *sem_wake_up_first(semaphore_t *s) {
+    task_t * task;
+
+    if (s->flags & SEM_PRIO) {
+        task = sem_heap_remove(s, 0);
+        sem_record_wait(s, task);
+    } else {
+        task = *(s->suspended_tasks);
+        queue_remove((queue_t**) s->suspended_tasks, (queue_t*) task); //remove da lista de tarefas
+    }
 
     #ifdef DEBUG
-        printf("[Semaphore Wake Up First] removendo a tarefa de id %d das lista de tarefas do semaforo\n", task->id);
+        printf("[Semaphore Wake Up First] tarefa de id %d removida da lista de tarefas do semaforo\n", task->id);
     #endif
-    queue_remove((queue_t**) s->suspended_tasks, (queue_t*) task); //remove da lista de tarefas
 
     //adicionar na lista de ativas
     #ifdef DEBUG
@@ -352,7 +2434,9 @@ void sem_wake_up_first(semaphore_t *s) {
     queue_append((queue_t**) dispatcher_active_tasks, (queue_t*) task);
     active_tasks += 1;
 
+    timed_wait_stop(task);
     task->status = TASK_RUNNING;
+    return task;
 }
 
 // libera o semáforo
@@ -377,13 +2461,115 @@ int sem_up (semaphore_t *s) {
         #ifdef DEBUG
             printf("[Semaphore Up] acordando primeira tarefa\n");
         #endif
+        s->task_counter -= 1;
+        task_t *task = sem_wake_up_first(s);
+
+        // o contador já foi repassado à tarefa acordada (continua <= 0), então
+        // em modo handoff ela pode rodar já, sem esperar pelo dispatcher
+        if ((s->flags & SEM_HANDOFF) && current_task && current_task != dispatcher_task) {
+            #ifdef DEBUG
+                printf("[Semaphore Up] handoff da tarefa %d para a tarefa %d\n", current_task->id, task->id);
+            #endif
+            task->ticks = QUANTUM;
+            task->activations += 1;
+            task_switch(task);
+        }
+    } else if (s->pollers && s->counter > 0) {
+        sem_wake_pollers(s);
+    }
+    can_preempt = 1;
+    return 0;
+}
+
+// libera n unidades do semáforo de uma vez, acordando até n tarefas
+int sem_up_n (semaphore_t *s, int n) {
+    if (!(s)) {
+        #ifdef DEBUG
+            perror("[ERRO] O semáforo não existe!\n");
+        #endif
+        return -1;
+    }
+
+    can_preempt = 0;
+    s->counter += n;
+
+    for (; n > 0 && s->task_counter > 0; n--) {
         s->task_counter -= 1;
         sem_wake_up_first(s);
     }
+
+    if (s->task_counter == 0 && s->pollers && s->counter > 0)
+        sem_wake_pollers(s);
+
     can_preempt = 1;
     return 0;
 }
 
+// define as opções do semáforo
+int sem_setflags (semaphore_t *s, int flags) {
+    if (!(s) || !(s->suspended_tasks)) {
+        #ifdef DEBUG
+            perror("[ERRO] O semáforo não existe!\n");
+        #endif
+        return -1;
+    }
+
+    // a fila de espera não pode mudar de estrutura com tarefas dentro
+    if (((s->flags ^ flags) & SEM_PRIO) && s->task_counter > 0) {
+        #ifdef DEBUG
+            perror("[ERRO] Há tarefas esperando no semáforo!\n");
+        #endif
+        return -1;
+    }
+
+    if ((flags & SEM_PRIO) && !(s->wait_hist))
+        s->wait_hist = calloc(PRIORITY_LEVELS * SEM_WAIT_BUCKETS, sizeof(unsigned int));
+
+    s->flags = flags;
+    return 0;
+}
+
+// maior tempo de espera (ms) da faixa do histograma que contém o percentil p
+unsigned int sem_hist_percentile(unsigned int *hist, unsigned int samples, int p) {
+    unsigned int needed = (samples * p + 99) / 100;
+    unsigned int seen = 0;
+
+    for (int bucket = 0; bucket < SEM_WAIT_BUCKETS; bucket++) {
+        seen += hist[bucket];
+        if (seen >= needed)
+            return (1u << bucket) - 1;
+    }
+    return (1u << (SEM_WAIT_BUCKETS - 1)) - 1;
+}
+
+// imprime os percentis de tempo de espera por nível de prioridade
+void sem_print_stats (semaphore_t *s) {
+    if (!(s) || !(s->wait_hist)) {
+        #ifdef DEBUG
+            perror("[ERRO] O semáforo não coleta estatísticas!\n");
+        #endif
+        return;
+    }
+
+    printf("Semaphore %d wait times (ms, upper bounds):\n", s->id);
+    for (int level = 0; level < PRIORITY_LEVELS; level++) {
+        unsigned int *hist = &s->wait_hist[level * SEM_WAIT_BUCKETS];
+        unsigned int samples = 0;
+
+        for (int bucket = 0; bucket < SEM_WAIT_BUCKETS; bucket++)
+            samples += hist[bucket];
+
+        if (samples == 0)
+            continue;
+
+        printf("  prio %3d: %6u waits, p50 <= %u, p90 <= %u, p99 <= %u\n",
+            level + MIN_PRIORITY, samples,
+            sem_hist_percentile(hist, samples, 50),
+            sem_hist_percentile(hist, samples, 90),
+            sem_hist_percentile(hist, samples, 99));
+    }
+}
+
 
 // destroi o semáforo, liberando as tarefas bloqueadas
 int sem_destroy (semaphore_t *s) {
@@ -398,6 +2584,19 @@ int sem_destroy (semaphore_t *s) {
     free(s->suspended_tasks);
     s->suspended_tasks = NULL;
 
+    // tarefas em ppos_wait_any veem o semáforo destruído como pronto
+    if (s->pollers) {
+        sem_wake_pollers(s);
+        while (s->pollers)
+            queue_remove((queue_t**) &s->pollers, (queue_t*) s->pollers);
+    }
+
+    free(s->heap);
+    s->heap = NULL;
+    s->heap_size = s->heap_capacity = 0;
+    free(s->wait_hist);
+    s->wait_hist = NULL;
+
     can_preempt = old_can_preempt;
 
     return 0;
@@ -518,6 +2717,7 @@ void wake_up_task(task_t *task) {
     queue_append((queue_t**) dispatcher_active_tasks, (queue_t*) task);
     active_tasks += 1;
 
+    timed_wait_stop(task);
     task->status = TASK_RUNNING;
     task->waited_task = NULL;
 }
@@ -555,16 +2755,32 @@ void check_suspended_tasks(task_t** suspendend_tasks) {
     }
 }
 
-int task_join (task_t *task) {
+// retira da lista de suspensas uma tarefa cujo prazo de join expirou
+void join_cancel_wait(task_t *task) {
+    task_queue_unlink(dispatcher_suspended_tasks, task);
+    suspended_tasks -= 1;
+    task->waited_task = NULL;
+}
+
+// aguarda o encerramento de task; timeout < 0 espera indefinidamente,
+// timeout == 0 nunca bloqueia e timeout > 0 espera no máximo timeout ms
+int task_join_wait (task_t *task, int timeout) {
     task_t *self = current_task;
 
-    if (task == NULL || task->status == TASK_DEAD) {
+    if (task == NULL) {
         #ifdef DEBUG
             printf("[Task Join] a tarefa passada não existe. Retornando imediatamente.\n");
         #endif
         return -1;
     }
 
+    // já terminou: não há o que esperar, inclusive nas variantes _try/_timed
+    if (task->status == TASK_DEAD)
+        return task->exit_code;
+
+    if (timeout == 0)
+        return PPOS_EAGAIN;
+
     //remover da lista de ativas
     #ifdef DEBUG
         printf("[Task Join] removendo a tarefa de id %d da lista de tarefas ativas\n", self->id);
@@ -581,6 +2797,10 @@ int task_join (task_t *task) {
 
     self->status = TASK_SUSPENDED;
     self->waited_task = task;
+    self->wait_result = 0;
+
+    if (timeout > 0)
+        timed_wait_start(timeout, join_cancel_wait, task);
 
     //yield
     task_yield();
@@ -589,10 +2809,27 @@ int task_join (task_t *task) {
     #ifdef DEBUG
         printf("[Task Join] a tarefa de id %d voltou a ser processada\n", self->id);
     #endif
+    if (self->wait_result == PPOS_ETIMEDOUT)
+        return PPOS_ETIMEDOUT;
+
     int exit_code = task->exit_code;
     return exit_code;
 }
 
+int task_join (task_t *task) {
+    return task_join_wait(task, -1);
+}
+
+// aguarda o encerramento de outra task por até ms milissegundos
+int task_join_timed (task_t *task, int ms) {
+    return task_join_wait(task, ms > 0 ? ms : 0);
+}
+
+// obtém o código de encerramento de uma task, se ela já terminou
+int task_join_try (task_t *task) {
+    return task_join_wait(task, 0);
+}
+
 // ========================== P6 ==============================
 
 //variavel que contem os milisegundos desde o inicio da execução
@@ -693,9 +2930,12 @@ task_t *scheduler()
 void dispatcher_body () // dispatcher é uma tarefa
 {
     task_t *next = NULL;
-    while ( active_tasks > 0 || sleeping_tasks > 0)
+    while ( active_tasks > 0 || sleeping_tasks > 0 || timed_tasks > 0 || shm_waiting_tasks > 0 || disk->pending > 0)
     {
         check_sleeping_tasks();
+        check_timed_tasks();
+        check_shared_queues();
+        check_disk();
 
         if (active_tasks > 0) {  // pode ter tarefas dormentes
             next = NULL;
@@ -724,6 +2964,8 @@ void dispatcher_body () // dispatcher é uma tarefa
                 dispatcher_task->activations += 1 ;
                 //... // ações após retornar da tarefa "next", se houverem
             }
+        } else if (shm_waiting_tasks > 0) {
+            shm_idle(); // nada a executar: dorme até outro processo mover uma fila
         }
     }
 
@@ -817,15 +3059,18 @@ void ppos_init ()
     }
 
     // Construindo Disco
-    disk = malloc(sizeof(disk));
+    disk = calloc(1, sizeof(disk_t));
 
-    disk_task = malloc(sizeof(task_t));
+    disk_task = calloc(1, sizeof(task_t));
     task_create(disk_task, disk_mgr_body, NULL);
+    disk_task->is_user_task = 0;
 
+    // o tick não pode interromper o tratador no meio das filas do disco
     action.sa_handler = disk_signal_handler;
     sigemptyset (&action.sa_mask) ;
+    sigaddset (&action.sa_mask, SIGALRM) ;
     action.sa_flags = 0 ;
-    if (sigaction (SIGALRM, &action, 0) < 0)
+    if (sigaction (SIGUSR1, &action, 0) < 0)
     {
         perror ("Erro em sigaction: ") ;
         exit (1) ;
@@ -854,6 +3099,7 @@ int task_create (task_t *task,			// descritor da nova tarefa
 
     task->id = last_task_id;
     last_task_id++;
+    task->prev = task->next = NULL; //descritores alocados com malloc vêm sujos
     task->stack = malloc(STACKSIZE) ;
     task_setprio(task, 0);
     task->is_user_task = 1;
@@ -864,6 +3110,14 @@ int task_create (task_t *task,			// descritor da nova tarefa
     task->slept_time = -1;
     task->nap_time = -1;
     task->total_nap_time = 0;
+    task->futex_addr = NULL;
+    task->timed_prev = task->timed_next = NULL;
+    task->wait_cancel = NULL;
+    task->wait_obj = NULL;
+    task->wait_result = 0;
+    task->wait_ready = -1;
+    task->disk_last_block = -1;
+    task->disk_ra_window = 0;
 
     task->creation_time = systime(); //cria com a data atual
     task->activations = 0; //numero de vezes que foi ativa
@@ -944,6 +3198,7 @@ int task_switch (task_t *task)
 {
     previous_task = current_task;
     current_task = task;
+    context_switches++;
 
     #ifdef DEBUG
         printf("[Task Switch] Trocando da tarefa %d para %d\n", current_task->id, task->id);
@@ -957,6 +3212,11 @@ int task_switch (task_t *task)
     return 0;
 }
 
+unsigned long ppos_switches () 
+{
+    return context_switches;
+}
+
 // retorna o identificador da tarefa corrente (main deve ser 0)
 int task_id () 
 {
@@ -30,16 +30,45 @@ typedef struct task_t
    unsigned int slept_time; //momento que foi dormir
    unsigned int nap_time; //tempo que deve dormir
    unsigned long total_nap_time; //tempo que deve dormir
+   int *futex_addr; //se suspensa em ppos_wait, endereço esperado
+   unsigned int wait_start; //momento em que bloqueou no semáforo
+   unsigned long wait_seq; //ordem de chegada no heap do semáforo (SEM_PRIO)
+   int wait_prio; //prioridade ao entrar no heap do semáforo (SEM_PRIO)
+   int heap_index; //posição no heap do semáforo (SEM_PRIO)
+   struct task_t *timed_prev, *timed_next; //lista de esperas com prazo
+   unsigned int deadline; //fim do prazo da espera (_timed)
+   int wait_result; //0 ou PPOS_ETIMEDOUT, ao sair de uma espera com prazo
+   void (*wait_cancel)(struct task_t *); //retira a tarefa da espera ao expirar
+   void *wait_obj; //objeto em que a tarefa está bloqueada
+   int wait_ready; //índice do objeto que acordou a tarefa em ppos_wait_any
+   int disk_last_block; //último bloco lido, para detectar leitura sequencial
+   int disk_ra_window; //janela de leitura antecipada da tarefa, em blocos
    // ... (outros campos serão adicionados mais tarde)
 } task_t ;
 
+// registro de uma tarefa bloqueada em ppos_wait_any num semáforo
+typedef struct poller_t
+{
+  struct poller_t *prev, *next ;	// ponteiros para usar em filas
+  struct semaphore_t *sem ;		// semáforo monitorado
+  task_t *task ;
+  int index ;				// posição do objeto no vetor de ppos_wait_any
+} poller_t ;
+
 // estrutura que define um semáforo
-typedef struct
+typedef struct semaphore_t
 {
   int id;
   int counter;
   task_t **suspended_tasks;
   int task_counter;
+  int flags; // opções definidas por sem_setflags
+  task_t **heap; // fila de espera ordenada por prioridade (SEM_PRIO)
+  int heap_size;
+  int heap_capacity;
+  unsigned long heap_seq;
+  unsigned int *wait_hist; // histograma de espera por prioridade (SEM_PRIO)
+  poller_t *pollers; // tarefas em ppos_wait_any sobre este semáforo
   // preencher quando necessário
 } semaphore_t ;
 
@@ -55,6 +84,38 @@ typedef struct
   // preencher quando necessário
 } barrier_t ;
 
+// níveis de urgência das filas MQUEUE_PRIO (0 é o mais urgente)
+#define MQUEUE_PRIO_LEVELS 8
+
+// faixas dos histogramas das filas: 0, 1, 2-3, 4-7, ... (como nos semáforos)
+#define MQUEUE_HIST_BUCKETS 16
+
+// cabeçalho do segmento de memória compartilhada de uma fila entre
+// processos (mqueue_open_shared); as mensagens vêm depois de seq[]
+typedef struct
+{
+  unsigned int magic ; // MQUEUE_SHM_MAGIC depois de inicializado
+  int max_msgs, msg_size ;
+  unsigned int head, tail ; // próximas posições a ler e a escrever
+  unsigned int sends, recvs ; // operações concluídas; quem espera os observa
+  unsigned int events ; // futex: muda a cada commit/release
+  int sleepers ; // dispatchers dormindo em events
+  unsigned int seq[] ; // posição em que cada vaga fica livre/ocupada
+} mqueue_shm_t ;
+
+// estatísticas de uma fila de mensagens (mqueue_stats)
+typedef struct
+{
+  unsigned long sends, recvs ;
+  unsigned int send_blocks, recv_blocks ; // esperas que bloquearam
+  unsigned long send_blocked_ms, recv_blocked_ms ; // tempo total bloqueado
+  unsigned int send_wait_hist[MQUEUE_HIST_BUCKETS] ; // duração dos bloqueios (ms)
+  unsigned int recv_wait_hist[MQUEUE_HIST_BUCKETS] ;
+  unsigned int residence_hist[MQUEUE_HIST_BUCKETS] ; // tempo na fila (ms)
+  unsigned int occupancy_hist[MQUEUE_HIST_BUCKETS] ; // ocupação após cada chamada de envio
+  int high_water ; // maior ocupação observada
+} mqueue_stats_t ;
+
 // estrutura que define uma fila de mensagens
 typedef struct
 {
@@ -65,10 +126,74 @@ typedef struct
   void* next_position;
   semaphore_t *s_items;
   semaphore_t *s_empty_lots;
-  semaphore_t *s_buffer;
+  semaphore_t *s_buffer; // exclusão mútua entre produtores
+  semaphore_t *s_recv_buffer; // exclusão mútua entre consumidores
   void* buffer;
+  int flags; // opções de mqueue_create_flags
+  unsigned int spsc_head; // próxima mensagem a receber (MQUEUE_SPSC)
+  unsigned int spsc_tail; // próxima vaga a preencher (MQUEUE_SPSC)
+  int spsc_recv_waiting; // consumidor dormindo em spsc_tail
+  int spsc_send_waiting; // produtor dormindo em spsc_head
+  int var_free; // bytes livres no anel (MQUEUE_VARLEN)
+  int *prio_ring; // MQUEUE_PRIO: um anel de índices de vagas por nível
+  int prio_head[MQUEUE_PRIO_LEVELS]; // próxima mensagem de cada nível
+  int prio_count[MQUEUE_PRIO_LEVELS]; // mensagens em cada nível
+  unsigned int prio_mask; // bit i ligado se o nível i tem mensagens
+  int *prio_free; // pilha de vagas livres
+  int prio_nfree;
+  int send_prio; // nível da mensagem reservada pelo produtor
+  int recv_level; // nível da mensagem obtida pelo consumidor
+  int overflow; // política com a fila cheia (mqueue_set_overflow)
+  int dropped; // mensagens descartadas pela política
+  mqueue_stats_t stats;
+  unsigned int *stamps; // instante de envio de cada mensagem na fila
+  int stamps_len;
+  int resize_min, resize_max; // limites de mqueue_set_resize (0: tamanho fixo)
+  int ring_used; // mensagens no anel
+  int quiet_recvs; // recebimentos seguidos com a fila quase vazia
+  mqueue_shm_t *shm; // segmento compartilhado (mqueue_open_shared)
+  size_t shm_bytes;
+  unsigned int shm_send_pos, shm_recv_pos; // posições reservadas
+  int shm_send_waiting, shm_recv_waiting; // tarefas locais esperando
+  unsigned int shm_sends_seen, shm_recvs_seen; // vistos pelo dispatcher
   // preencher quando necessário
 } mqueue_t ;
 
+// estrutura que define um canal de difusão (publish/subscribe)
+typedef struct channel_t
+{
+  int id;
+  int max_msgs;
+  int msg_size;
+  int policy; // CHANNEL_BLOCK ou CHANNEL_LAP
+  void* buffer;
+  unsigned int tail; // mensagens já publicadas
+  unsigned int reads; // leituras feitas; o produtor bloqueado espera aqui
+  int recv_waiting; // assinantes dormindo em tail
+  int send_waiting; // produtor dormindo em reads
+  semaphore_t *s_publish; // exclusão mútua entre produtores
+  int publishing; // produtores dentro de channel_publish, que ainda usam s_publish
+  struct subscriber_t *subscribers; // fila de assinantes
+} channel_t ;
+
+// estrutura que define um assinante de um canal
+typedef struct subscriber_t
+{
+  struct subscriber_t *prev, *next; // para usar com a biblioteca de filas
+  channel_t *channel;
+  unsigned int cursor; // próxima mensagem a ler
+  unsigned int lost; // mensagens perdidas por ter sido ultrapassado
+} subscriber_t ;
+
+// objeto monitorado por ppos_wait_any
+#define WAITOBJ_SEM	0	// pronto quando sem_down não bloquearia
+#define WAITOBJ_MQUEUE	1	// pronto quando há mensagens para receber
+
+typedef struct
+{
+  int type ;		// WAITOBJ_SEM ou WAITOBJ_MQUEUE
+  void *object ;	// semaphore_t * ou mqueue_t *
+} waitobj_t ;
+
 #endif
 
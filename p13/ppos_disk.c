@@ -1,12 +1,40 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <signal.h>
+#include <strings.h>
+#include <string.h>
 #include "hard_disk.h"
 #include "ppos.h"
 #include "ppos_disk.h"
 
-#define TASK_SUSPENDED 0 // must be the same as defined in ppos_core.c
-
-
-disk_request_t **disk_requests;
-int disk_requests_count;
+// O disco aceita até DISK_QUEUE_DEPTH comandos, identificados por tags, e os
+// reordena pela distância da cabeça. Novos comandos são enviados no próprio
+// tratador do SIGUSR1, sem esperar o gerente ser escalonado, então a fila do
+// disco não esvazia enquanto há pedidos. O tratador só mexe nas filas do
+// disco (requests, inflight, done); quem acorda as tarefas é o gerente, que o
+// dispatcher põe para rodar quando vê disk->signaled. A tarefa espera o
+// pedido com ppos_wait em request->completed, então pode ter vários pedidos
+// no disco ao mesmo tempo (disk_submit_read/write) e só acorda pelo seu.
+//
+// O tempo de acesso do disco cresce com a distância entre blocos, então o
+// pedido enviado é escolhido por disk_pick (SSTF ou C-SCAN) em vez da ordem
+// de chegada. Cada direção tem sua fila em ordem de chegada: a cabeça mais
+// antiga das duas é o pedido mais antigo, e depois de DISK_MAX_SKIPS
+// escolhas que o preterem ele é atendido.
+//
+// Na política DISK_DEADLINE o disco atende lotes de uma direção em ordem
+// C-SCAN, preferindo leituras, e pula para a cabeça de uma fila assim que o
+// prazo dela vence; com as duas vencidas, vai a de prazo mais antigo, senão
+// as leituras (que vencem em DISK_READ_EXPIRE) adiariam uma escrita vencida
+// sem limite. A ordem por bloco sai de uma varredura da fila da direção, O(n)
+// por escolha: com pedidos assíncronos e anéis ela pode ter até
+// DISK_NR_REQUESTS pedidos mais DISK_RING_SIZE por anel, poucos o bastante
+// para a varredura custar menos que manter uma lista ordenada a cada
+// inserção e junção.
+//
+// Pedidos da mesma direção para blocos vizinhos do escolhido vão juntos num
+// único comando READV/WRITEV: a busca é paga uma vez por comando, e não por
+// bloco. disk->inflight[tag] é a fila dos pedidos do comando com essa tag.
 
 extern task_t *disk_task;
 extern task_t *current_task;
@@ -14,144 +42,1339 @@ extern disk_t *disk;
 
 extern int can_preempt;
 
+// implementadas em ppos_core.c
+void suspend_disk_task() ;
+void spsc_publish(unsigned int *index, int count, int *waiting) ;
+
+// impede o tratador do SIGUSR1 e a preempção de mexer nas filas do disco;
+// devolve o can_preempt anterior, para disk_unlock restaurar
+int disk_lock(sigset_t *old) {
+    sigset_t usr1;
+    int old_can_preempt = can_preempt;
+
+    can_preempt = 0;
+    sigemptyset(&usr1);
+    sigaddset(&usr1, SIGUSR1);
+    sigprocmask(SIG_BLOCK, &usr1, old);
+    return old_can_preempt;
+}
+
+void disk_unlock(sigset_t *old, int old_can_preempt) {
+    sigprocmask(SIG_SETMASK, old, NULL);
+    can_preempt = old_can_preempt;
+}
+
 int create_disk_request(disk_request_t *request, enum disk_request_type type, int block, void *buffer) {
+    request->prev = request->next = NULL;
     request->task = current_task;
+    request->callback = NULL;
+    request->arg = NULL;
+    request->user_data = NULL;
     request->type = type;
     request->block = block;
+    request->result = 0;
+    request->completed = 0;
+    request->skipped = 0;
+    request->arrival = systime();
+    request->deadline = request->arrival + ((type == DISK_READ) ? DISK_READ_EXPIRE : DISK_WRITE_EXPIRE);
 
-    if (type == write) { // se o tipo for igual a write, copia para o buffer
-        request->buffer = malloc(disk->blocks_size);
-        bcopy(buffer, request->buffer, disk->blocks_size);
-    }  else {
-        request->buffer = buffer;
-    }
+    // leituras e escritas usam o buffer de quem pediu, sem cópia: ele não
+    // pode ser alterado até o pedido ser concluído
+    request->buffer = buffer;
 
     return 0;
 
 }
 
-int destroy_disk_request(disk_request_t *request) {
-    if (request->type == write)  // se o tipo for igual a write, copia para o buffer
-        free(request->buffer); 
+// Os pedidos vêm de disk->request_pool, sem malloc por pedido. O conjunto só
+// é usado no contexto das tarefas e do gerente, protegido por can_preempt.
+// Sem pedido livre, quem pode esperar dorme em disk->free_count; a leitura
+// antecipada e os pedidos assíncronos desistem.
+
+disk_request_t *disk_request_alloc(int wait) {
+    int old_can_preempt = can_preempt;
+    can_preempt = 0;
+
+    while (!(disk->free_requests)) {
+        if (!wait) {
+            can_preempt = old_can_preempt;
+            return NULL;
+        }
+        ppos_wait(&disk->free_count, 0);
+        can_preempt = 0;
+    }
+
+    disk_request_t *request = disk->free_requests;
+    disk->free_requests = request->next;
+    disk->free_count -= 1;
+
+    can_preempt = old_can_preempt;
+    return request;
+}
+
+void disk_request_free(disk_request_t *request) {
+    int old_can_preempt = can_preempt;
+    can_preempt = 0;
+
+    request->next = disk->free_requests;
+    disk->free_requests = request;
+    disk->free_count += 1;
+    ppos_wake(&disk->free_count, 1);
+
+    can_preempt = old_can_preempt;
+}
+
+// distância de busca até o pedido segundo a política corrente
+int disk_seek_cost(disk_request_t *request) {
+    int distance = request->block - disk->head;
+
+    if (disk->policy == DISK_CSCAN || disk->policy == DISK_DEADLINE)
+        return (distance < 0) ? distance + disk->num_blocks : distance;
+    return abs(distance);
+}
+
+// pedido de menor custo de busca em uma fila (NULL se vazia)
+disk_request_t *disk_nearest(disk_request_t *queue) {
+    disk_request_t *best = queue;
+    disk_request_t *request = queue;
+
+    if (!queue)
+        return NULL;
+
+    do {
+        if (disk_seek_cost(request) < disk_seek_cost(best))
+            best = request;
+        request = request->next;
+    } while (request != queue);
+
+    return best;
+}
+
+int disk_expired(disk_request_t *request) {
+    return request && (int) (systime() - request->deadline) >= 0;
+}
+
+// lotes de uma direção em ordem C-SCAN; um prazo vencido interrompe o lote
+disk_request_t *disk_pick_deadline() {
+    disk_request_t *reads = disk->requests[DISK_READ];
+    disk_request_t *writes = disk->requests[DISK_WRITE];
+
+    if (disk_expired(reads) || disk_expired(writes)) {
+        disk_request_t *request = reads;
+        if (!disk_expired(reads) || (disk_expired(writes) && (int) (writes->deadline - reads->deadline) < 0))
+            request = writes;
+        disk->batch_type = request->type;
+        disk->batch_left = DISK_DEADLINE_BATCH - 1;
+        disk->stats.expired += 1;
+        return request;
+    }
+
+    if (disk->batch_left <= 0 || !(disk->requests[disk->batch_type])) {
+        disk->batch_type = reads ? DISK_READ : DISK_WRITE;
+        disk->batch_left = DISK_DEADLINE_BATCH;
+    }
+
+    disk->batch_left -= 1;
+    return disk_nearest(disk->requests[disk->batch_type]);
+}
+
+// escolhe o próximo pedido a atender (as filas não podem estar vazias)
+disk_request_t *disk_pick() {
+    disk_request_t *reads = disk->requests[DISK_READ];
+    disk_request_t *writes = disk->requests[DISK_WRITE];
+
+    if (disk->policy == DISK_DEADLINE)
+        return disk_pick_deadline();
+
+    disk_request_t *oldest = reads;
+    if (!reads || (writes && (int) (writes->arrival - reads->arrival) < 0))
+        oldest = writes;
+
+    if (disk->policy == DISK_FCFS || oldest->skipped >= DISK_MAX_SKIPS)
+        return oldest;
+
+    disk_request_t *best = disk_nearest(reads);
+    disk_request_t *nearest_write = disk_nearest(writes);
+    if (!best || (nearest_write && disk_seek_cost(nearest_write) < disk_seek_cost(best)))
+        best = nearest_write;
+
+    if (best != oldest)
+        oldest->skipped += 1;
+    return best;
+}
+
+// pedido da fila de uma direção para o bloco dado (NULL se não houver)
+disk_request_t *disk_find(int type, int block) {
+    disk_request_t *queue = disk->requests[type];
+    disk_request_t *request = queue;
+
+    if (!queue)
+        return NULL;
+
+    do {
+        if (request->block == block)
+            return request;
+        request = request->next;
+    } while (request != queue);
+
+    return NULL;
+}
+
+// junta ao comando os pedidos da mesma direção para blocos vizinhos do
+// escolhido, montando em *command a fila em ordem de bloco e em disk->iov os
+// buffers; devolve o primeiro bloco do comando
+int disk_merge(disk_request_t *first, disk_request_t **command) {
+    int low = first->block, high = first->block, count = 1;
+    disk_request_t *request;
+
+    *command = NULL;
+    queue_append((queue_t**) command, (queue_t*) first);
+
+    while (count < DISK_IOV_MAX && (request = disk_find(first->type, high + 1))) {
+        queue_remove((queue_t**) &disk->requests[first->type], (queue_t*) request);
+        queue_append((queue_t**) command, (queue_t*) request);
+        high++;
+        count++;
+    }
+
+    while (count < DISK_IOV_MAX && (request = disk_find(first->type, low - 1))) {
+        queue_remove((queue_t**) &disk->requests[first->type], (queue_t*) request);
+        queue_append((queue_t**) command, (queue_t*) request);
+        *command = request; // entra antes do primeiro na fila circular
+        low--;
+        count++;
+    }
+
+    request = *command;
+    disk->iov.count = 0;
+    do {
+        disk->iov.buffers[disk->iov.count++] = request->buffer;
+        request = request->next;
+    } while (request != *command);
+
+    return low;
+}
+
+// move os pedidos de um comando para a lista de concluídos
+void disk_complete(disk_request_t **command, int result) {
+    while (*command) {
+        disk_request_t *request = *command;
+        queue_remove((queue_t**) command, (queue_t*) request);
+
+        request->result = result;
+        if (result == 0) {
+            unsigned int latency = systime() - request->arrival;
+            disk->stats.served += 1;
+            disk->stats.latency_total += latency;
+            if (latency > disk->stats.latency_max)
+                disk->stats.latency_max = latency;
+            disk->stats.type_served[request->type] += 1;
+            disk->stats.type_latency[request->type] += latency;
+            if (latency > disk->stats.type_latency_max[request->type])
+                disk->stats.type_latency_max[request->type] = latency;
+        }
+
+        queue_append((queue_t**) &disk->done, (queue_t*) request);
+    }
+    disk->signaled = 1;
+}
+
+// enche a fila de comandos do disco (até disk->depth): cada comando é o
+// pedido escolhido pela política mais os vizinhos que couberem num
+// READV/WRITEV. Se o disco recusar, os pedidos vão direto para a lista de
+// concluídos com erro. Chamada com o SIGUSR1 bloqueado ou de dentro do
+// tratador.
+void disk_start_next() {
+    while ((disk->requests[DISK_READ] || disk->requests[DISK_WRITE]) && disk->inflight_count < disk->depth) {
+        disk_request_t *command;
+        disk_request_t *request = disk_pick();
+        queue_remove((queue_t**) &disk->requests[request->type], (queue_t*) request);
+
+        int block = disk_merge(request, &command);
+        int count = disk->iov.count;
+        int tag;
+
+        if (count == 1)
+            tag = disk_cmd((request->type == DISK_READ) ? DISK_CMD_READ : DISK_CMD_WRITE, block, request->buffer);
+        else
+            tag = disk_cmd((request->type == DISK_READ) ? DISK_CMD_READV : DISK_CMD_WRITEV, block, &disk->iov);
+
+        if (tag >= 0) {
+            disk->inflight[tag] = command;
+            disk->inflight_count += 1;
+            disk->stats.commands += 1;
+            disk->stats.merged += count - 1;
+            disk->head = block + count - 1;
+        } else {
+            disk_complete(&command, -1);
+        }
+    }
+}
+
+void disk_signal_handler (int signum) {
+    int tag;
+
+    // um sinal pode representar várias conclusões
+    while ((tag = disk_cmd(DISK_CMD_DONE, 0, 0)) >= 0) {
+        if (!(disk->inflight[tag]))
+            continue;
+        // o disco executa os comandos um por vez: a ordem de conclusão é a
+        // ordem em que a cabeça passou por eles
+        disk_request_t *command = disk->inflight[tag];
+        disk->stats.head_travel += abs(command->block - disk->device_head);
+        disk->device_head = command->prev->block;
+
+        disk_complete(&disk->inflight[tag], 0);
+        disk->inflight_count -= 1;
+    }
+
+    // mantém o disco ocupado antes mesmo de o gerente rodar
+    disk_start_next();
+}
+
+int disk_set_scheduler (int policy) {
+    sigset_t old;
+
+    if (policy < DISK_FCFS || policy > DISK_DEADLINE) {
+        #ifdef DEBUG
+            perror("[ERRO] Política de escalonamento de disco inválida!\n");
+        #endif
+        return -1;
+    }
+
+    int old_can_preempt = disk_lock(&old);
+    disk->policy = policy;
+    disk->batch_left = 0;
+    memset(&disk->stats, 0, sizeof(disk_stats_t));
+    disk_unlock(&old, old_can_preempt);
 
     return 0;
 }
 
+int disk_stats (disk_stats_t *stats) {
+    sigset_t old;
+
+    if (!(stats))
+        return -1;
+
+    int old_can_preempt = disk_lock(&old);
+    *stats = disk->stats;
+    stats->cache_dirty = disk->cache_dirty;
+    disk_unlock(&old, old_can_preempt);
+
+    return 0;
+}
+
+void disk_print_stats () {
+    disk_stats_t st;
+    char *names[] = {"FCFS", "SSTF", "C-SCAN", "deadline"};
+
+    disk_stats(&st);
+    printf("Disk (%s): %lu requests, head travel %lu blocks (%.1f per request)\n",
+        names[disk->policy], st.served, st.head_travel,
+        st.served ? (double) st.head_travel / st.served : 0.0);
+    printf("  latency mean %lu ms, max %u ms\n",
+        st.served ? st.latency_total / st.served : 0, st.latency_max);
+    if (st.merged)
+        printf("  %lu device commands, %lu requests merged into neighbours\n",
+            st.commands, st.merged);
+    if (st.type_served[DISK_READ] && st.type_served[DISK_WRITE]) {
+        printf("  reads  mean %lu ms, max %u ms\n",
+            st.type_latency[DISK_READ] / st.type_served[DISK_READ], st.type_latency_max[DISK_READ]);
+        printf("  writes mean %lu ms, max %u ms\n",
+            st.type_latency[DISK_WRITE] / st.type_served[DISK_WRITE], st.type_latency_max[DISK_WRITE]);
+    }
+    if (disk->policy == DISK_DEADLINE)
+        printf("  %lu requests served early on deadline\n", st.expired);
+    if (disk->cache) {
+        unsigned long accesses = st.cache_hits + st.cache_misses;
+        printf("  cache %d blocks: %lu hits, %lu misses (hit ratio %.1f%%), %lu writebacks, %d dirty\n",
+            disk->cache_size, st.cache_hits, st.cache_misses,
+            accesses ? 100.0 * st.cache_hits / accesses : 0.0, st.cache_writebacks, st.cache_dirty);
+        if (st.readahead_issued)
+            printf("  read-ahead: %lu blocks, %lu used, %lu evicted unused\n",
+                st.readahead_issued, st.readahead_hits, st.readahead_wasted);
+    }
+}
+
 int disk_mgr_init (int *numBlocks, int *blockSize) {
     #ifdef DEBUG
         printf("[Disk Manager Init] Inicializando disco...!\n");
     #endif
 
-    int error = 0;
-
     if (disk_cmd(DISK_CMD_INIT, 0, 0)) {
         #ifdef DEBUG
             perror("[ERRO] Inicialização do disco deu errado!\n");
         #endif
-        error = 1;
+        return -1;
     }
 
-    int result = disk_cmd (DISK_CMD_DISKSIZE, 0, 0);
-    if (result < 0) {
+    int num_blocks = disk_cmd (DISK_CMD_DISKSIZE, 0, 0);
+    if (num_blocks < 0) {
         #ifdef DEBUG
             perror("[ERRO] Erro pegando o tamanho do disco!\n");
         #endif
-        error = 1;
+        return -1;
     }
 
-    int disk_size = result; 
-
-    int result = disk_cmd (DISK_CMD_DISKSIZE, 0, 0);
-    if (result < 0) {
+    int block_size = disk_cmd (DISK_CMD_BLOCKSIZE, 0, 0);
+    if (block_size < 0) {
         #ifdef DEBUG
             perror("[ERRO] Erro pegando o tamanho do bloco!\n");
         #endif
-        error = 1;
+        return -1;
     }
 
-    *blockSize = result;
-    *numBlocks = disk_size / result;
+    *numBlocks = num_blocks;
+    *blockSize = block_size;
 
-    disk->blocks_size = blockSize;
-    disk->num_blocks = numBlocks;
+    disk->blocks_size = block_size;
+    disk->num_blocks = num_blocks;
+    disk->requests[DISK_READ] = disk->requests[DISK_WRITE] = NULL;
+    memset(disk->inflight, 0, sizeof(disk->inflight));
+    disk->inflight_count = 0;
+    disk->depth = 1;
+    disk->done = NULL;
+    disk->signaled = 0;
+    disk->policy = DISK_SSTF;
+    disk->head = disk->device_head = 0;
+    disk->ra_max = DISK_RA_MAX;
+    disk->pending = 0;
+    disk->rings = NULL;
+    disk->free_requests = NULL;
+    disk->free_count = 0;
+    for (int i = 0; i < DISK_NR_REQUESTS; i++)
+        disk_request_free(&disk->request_pool[i]);
+    memset(&disk->stats, 0, sizeof(disk_stats_t));
 
     #ifdef DEBUG
-        printf("[Disk Manager Init] Criando fila de pedidos\n", numBlocks, blockSize);
+        printf("[Disk Manager Init] Disco inicializado com %d blocos, sendo que cada bloco tem %d bytes\n", num_blocks, block_size);
     #endif
 
-    disk_requests = (disk_request_t **)malloc(sizeof(disk_request_t *));
-    (*disk_requests) = NULL;
-    disk_requests = 0;
+    return 0;
+}
+
+// inclui o pedido na fila do disco; o disco ocioso começa a atendê-lo já
+void disk_submit(disk_request_t *request) {
+    sigset_t old;
 
-    #ifdef DEBUG
-        printf("[Disk Manager Init] Disco inicializado com %d blocos, sendo que cada bloco tem %d bytes\n", numBlocks, blockSize);
-    #endif
+    int old_can_preempt = disk_lock(&old);
+    queue_append((queue_t**) &disk->requests[request->type], (queue_t*) request);
+    disk->pending += 1;
+    disk_start_next();
+    disk_unlock(&old, old_can_preempt);
+}
+
+// suspende a tarefa até o pedido ser atendido e o libera
+int disk_wait_request(disk_request_t *request) {
+    // o gerente pode ter entregue o pedido antes de a tarefa suspender
+    while (!(request->completed))
+        ppos_wait(&request->completed, 0);
+    can_preempt = 1;
+
+    int result = request->result;
+    disk_request_free(request);
+
+    return result;
+}
+
+int disk_valid_request(int block, void *buffer) {
+    if (!(buffer) || block < 0 || block >= disk->num_blocks) {
+        #ifdef DEBUG
+            perror("[ERRO] Pedido de disco inválido!\n");
+        #endif
+        return 0;
+    }
+    return 1;
+}
+
+// inclui o pedido na fila do disco e suspende a tarefa até ele ser atendido
+int disk_request(enum disk_request_type type, int block, void *buffer) {
+    if (!disk_valid_request(block, buffer))
+        return -1;
+
+    disk_request_t *request = disk_request_alloc(1);
+    create_disk_request(request, type, block, buffer);
+    disk_submit(request);
+
+    return disk_wait_request(request);
+}
+
+// ========================== Cache de blocos ============================== 
+
+// Tabela hash de número de bloco para buffer, com substituição pelo relógio
+// (CLOCK): um acerto só liga o bit de referência. O cache roda no contexto
+// das tarefas, protegido por can_preempt; um buffer em E/S fica busy e quem o
+// quer espera com ppos_wait. Toda E/S pode suspender a tarefa, então depois
+// dela a busca recomeça do início.
+
+disk_buffer_t *disk_cache_lookup(int block) {
+    disk_buffer_t *buffer = disk->cache_hash[block & disk->cache_hash_mask];
+
+    while (buffer && buffer->block != block)
+        buffer = buffer->hash_next;
+    return buffer;
+}
+
+void disk_cache_unhash(disk_buffer_t *buffer) {
+    disk_buffer_t **link = &disk->cache_hash[buffer->block & disk->cache_hash_mask];
+
+    while (*link != buffer)
+        link = &(*link)->hash_next;
+    *link = buffer->hash_next;
+    buffer->hash_next = NULL;
+    buffer->block = -1;
+}
+
+void disk_cache_rehash(disk_buffer_t *buffer, int block) {
+    if (buffer->block >= 0)
+        disk_cache_unhash(buffer);
+
+    if (buffer->readahead) {
+        disk->stats.readahead_wasted += 1;
+        buffer->readahead = 0;
+    }
+
+    disk_buffer_t **link = &disk->cache_hash[block & disk->cache_hash_mask];
+    buffer->block = block;
+    buffer->hash_next = *link;
+    *link = buffer;
+}
+
+// libera o buffer da E/S e acorda quem o esperava
+void disk_cache_release(disk_buffer_t *buffer) {
+    buffer->busy = 0;
+    ppos_wake(&buffer->busy, -1);
+    disk->cache_released += 1;
+    ppos_wake(&disk->cache_released, -1);
+
+    // um anel pode ter deixado um pedido para este bloco esperando no gerente
+    if (disk->rings)
+        disk->signaled = 1;
+}
+
+// escolhe um buffer para substituir; NULL se todos estão em E/S
+disk_buffer_t *disk_cache_victim() {
+    for (int i = 0; i < 2 * disk->cache_size; i++) {
+        disk_buffer_t *buffer = &disk->cache[disk->cache_hand];
+        disk->cache_hand = (disk->cache_hand + 1) % disk->cache_size;
+
+        if (buffer->busy)
+            continue;
+        if (buffer->referenced) {
+            buffer->referenced = 0;
+            continue;
+        }
+        return buffer;
+    }
+    return NULL;
+}
+
+// sobrescreve o bloco do buffer com data e o marca sujo
+void disk_cache_store(disk_buffer_t *buffer, void *data) {
+    bcopy(data, buffer->data, disk->blocks_size);
+    if (!(buffer->dirty)) {
+        buffer->dirty = 1;
+        disk->cache_dirty += 1;
+    }
+}
+
+// grava um buffer sujo (suspende a tarefa)
+int disk_cache_writeback(disk_buffer_t *buffer) {
+    buffer->busy = 1;
+    int result = disk_request(DISK_WRITE, buffer->block, buffer->data);
+    can_preempt = 0;
+    if (result == 0) {
+        buffer->dirty = 0;
+        disk->cache_dirty -= 1;
+        disk->stats.cache_writebacks += 1;
+    }
+    disk_cache_release(buffer);
+    return result;
+}
+
+// devolve o buffer do bloco sem E/S em andamento, ou um buffer livre e limpo
+// já associado ao bloco (*hit = 0). Pode suspender a tarefa; retorna com
+// can_preempt = 0, ou NULL se a gravação de um buffer sujo falhou.
+disk_buffer_t *disk_cache_get(int block, int *hit) {
+    while (1) {
+        can_preempt = 0;
+
+        disk_buffer_t *buffer = disk_cache_lookup(block);
+        if (buffer) {
+            if (buffer->busy) {
+                ppos_wait(&buffer->busy, 1);
+                continue;
+            }
+            buffer->referenced = 1;
+            if (buffer->readahead) {
+                disk->stats.readahead_hits += 1;
+                buffer->readahead = 0;
+            }
+            *hit = 1;
+            return buffer;
+        }
+
+        buffer = disk_cache_victim();
+        if (!buffer) {
+            ppos_wait(&disk->cache_released, disk->cache_released);
+            continue;
+        }
+
+        if (buffer->dirty) {
+            if (disk_cache_writeback(buffer) < 0)
+                return NULL;
+            continue;
+        }
+
+        disk_cache_rehash(buffer, block);
+        buffer->referenced = 1;
+        *hit = 0;
+        return buffer;
+    }
+}
+
+// Leitura antecipada: cada tarefa lembra o último bloco que leu. Uma
+// leitura do bloco seguinte dobra a janela da tarefa (até disk->ra_max) e
+// pede ao disco, sem esperar, os blocos da janela que faltam no cache; uma
+// leitura fora de sequência fecha a janela. Os pedidos antecipados não têm
+// tarefa: o gerente entrega a conclusão a disk_cache_fill_done.
+
+// conclusão de uma leitura para o cache sem tarefa esperando (antecipada ou
+// abandonada por disk_block_read_timed)
+void disk_cache_fill_done(disk_request_t *request) {
+    disk_buffer_t *buffer = request->arg;
+
+    if (request->result < 0)
+        disk_cache_unhash(buffer);
+    disk_cache_release(buffer);
+
+    disk_request_free(request);
+}
+
+// chamada com can_preempt = 0; nunca suspende a tarefa
+void disk_readahead(int block) {
+    task_t *self = current_task;
+    int max = (disk->ra_max < disk->cache_size / 2) ? disk->ra_max : disk->cache_size / 2;
+
+    if (block == self->disk_last_block + 1)
+        self->disk_ra_window = self->disk_ra_window ? 2 * self->disk_ra_window : DISK_RA_MIN;
+    else
+        self->disk_ra_window = 0;
+    if (self->disk_ra_window > max)
+        self->disk_ra_window = max;
+    self->disk_last_block = block;
+
+    for (int next = block + 1; next <= block + self->disk_ra_window && next < disk->num_blocks; next++) {
+        if (disk_cache_lookup(next))
+            continue;
+
+        // só buffers limpos: gravar um sujo faria a tarefa esperar
+        disk_buffer_t *buffer = disk_cache_victim();
+        if (!buffer || buffer->dirty)
+            break;
+
+        disk_request_t *request = disk_request_alloc(0);
+        if (!request)
+            break;
+
+        disk_cache_rehash(buffer, next);
+        buffer->busy = 1;
+        buffer->readahead = 1;
+        buffer->referenced = 1;
 
-    return error;
+        create_disk_request(request, DISK_READ, next, buffer->data);
+        request->task = NULL;
+        request->callback = disk_cache_fill_done;
+        request->arg = buffer;
+
+        disk->stats.readahead_issued += 1;
+        disk_submit(request);
+    }
 }
 
 // leitura de um bloco, do disco para o buffer
 int disk_block_read (int block, void *buffer) {
-    // obtém o semáforo de acesso ao disco
-    sem_down(disk->disk_semaphore);
- 
-    // inclui o pedido na fila_disco
-    disk_request_t *request = malloc(sizeof(disk_request_t));
-    create_disk_request(request, read, block, buffer);
+    int hit;
 
-    disk_requests_count += 1;
-    queue_append((queue_t**) disk_requests, (queue_t*) request);
+    if (!(disk->cache) || !disk_valid_request(block, buffer))
+        return disk_request(DISK_READ, block, buffer);
 
-    if (disk_task->status == TASK_SUSPENDED)
-    {
-        // acorda o gerente de disco (põe ele na fila de prontas)
+    disk_buffer_t *cached = disk_cache_get(block, &hit);
+    if (!cached) {
+        can_preempt = 1;
+        return -1;
     }
 
-    // libera semáforo de acesso ao disco
-    sem_up(disk->disk_semaphore);
+    if (!hit) {
+        disk->stats.cache_misses += 1;
+        cached->busy = 1;
 
-    // suspende a tarefa corrente (retorna ao dispatcher)
-    can_preempt = 0;
-    suspend_disk_request_task();
-    can_preempt = 1;
+        // o pedido do próprio bloco entra na fila antes dos antecipados
+        disk_request_t *request = disk_request_alloc(1);
+        create_disk_request(request, DISK_READ, block, cached->data);
+        disk_submit(request);
+        disk_readahead(block);
+
+        if (disk_wait_request(request) < 0) {
+            can_preempt = 0;
+            disk_cache_unhash(cached);
+            disk_cache_release(cached);
+            can_preempt = 1;
+            return -1;
+        }
+        can_preempt = 0;
+        disk_cache_release(cached);
+    } else {
+        disk->stats.cache_hits += 1;
+    }
 
-    task_yield();
+    bcopy(cached->data, buffer, disk->blocks_size);
+
+    // num acerto o buffer não está busy: só depois da cópia ele pode ser
+    // escolhido para a leitura antecipada
+    if (hit)
+        disk_readahead(block);
+    can_preempt = 1;
+    return 0;
 }
 
 // escrita de um bloco, do buffer para o disco
 int disk_block_write (int block, void *buffer) {
+    int hit;
+
+    if (!(disk->cache) || !disk_valid_request(block, buffer))
+        return disk_request(DISK_WRITE, block, buffer);
+
+    // o bloco inteiro é sobrescrito: um miss não precisa ler o disco
+    disk_buffer_t *cached = disk_cache_get(block, &hit);
+    if (!cached) {
+        can_preempt = 1;
+        return -1;
+    }
 
+    if (hit)
+        disk->stats.cache_hits += 1;
+    else
+        disk->stats.cache_misses += 1;
+
+    disk_cache_store(cached, buffer);
+    can_preempt = 1;
+    return 0;
 }
 
+int disk_sync () {
+    int result = 0;
+
+    for (int i = 0; i < disk->cache_size; i++) {
+        disk_buffer_t *buffer = &disk->cache[i];
+
+        can_preempt = 0;
+        while (buffer->busy) {
+            ppos_wait(&buffer->busy, 1);
+            can_preempt = 0;
+        }
+        if (buffer->dirty && disk_cache_writeback(buffer) < 0)
+            result = -1;
+        can_preempt = 1;
+    }
+
+    return result;
+}
+
+// ========================== E/S assíncrona ============================== 
+
+// Um pedido assíncrono é o próprio disk_request_t, devolvido à tarefa depois
+// de entrar na fila do disco; disk_wait o espera e libera. Com o cache ligado,
+// um bloco presente no cache é lido nele na hora e o pedido já volta
+// concluído. Escritas sempre ficam no cache, como em disk_block_write: uma
+// escrita que fosse direto ao disco deixaria uma leitura do mesmo bloco, na
+// fila ao lado dela, pôr o conteúdo antigo no cache. Assim o disco só grava
+// buffers do cache, que ficam busy até o fim da gravação, e as leituras de
+// blocos fora do cache podem ir direto ao disco.
+
+// conta um acerto no buffer do cache
+void disk_cache_hit(disk_buffer_t *cached) {
+    cached->referenced = 1;
+    if (cached->readahead) {
+        disk->stats.readahead_hits += 1;
+        cached->readahead = 0;
+    }
+    disk->stats.cache_hits += 1;
+}
+
+// atende o pedido no buffer do cache, que não pode estar em E/S
+void disk_cache_copy(disk_buffer_t *cached, disk_request_t *request) {
+    disk_cache_hit(cached);
+
+    if (request->type == DISK_READ)
+        bcopy(cached->data, request->buffer, disk->blocks_size);
+    else
+        disk_cache_store(cached, request->buffer);
+
+    request->completed = 1;
+}
+
+// atende no cache um pedido cujo bloco está lá; retorna 0 se o bloco não
+// está no cache. Chamada e retorna com can_preempt = 0
+int disk_cache_serve(disk_request_t *request) {
+    disk_buffer_t *cached;
+
+    while ((cached = disk_cache_lookup(request->block)) && cached->busy) {
+        ppos_wait(&cached->busy, 1);
+        can_preempt = 0;
+    }
+    if (!cached)
+        return 0;
+
+    disk_cache_copy(cached, request);
+    return 1;
+}
+
+disk_request_t *disk_submit_async(enum disk_request_type type, int block, void *buffer) {
+    if (!disk_valid_request(block, buffer))
+        return NULL;
+
+    disk_request_t *request = disk_request_alloc(0);
+    if (!(request)) {
+        #ifdef DEBUG
+            perror("[ERRO] Sem pedidos de disco livres!\n");
+        #endif
+        return NULL;
+    }
+    create_disk_request(request, type, block, buffer);
+
+    if (disk->cache && type == DISK_WRITE) {
+        request->result = disk_block_write(block, buffer);
+        request->completed = 1;
+        return request;
+    }
+
+    // sem preempção entre a consulta ao cache e a entrada na fila do disco
+    can_preempt = 0;
+    if (!(disk->cache) || !disk_cache_serve(request))
+        disk_submit(request);
+    can_preempt = 1;
+
+    return request;
+}
+
+disk_request_t *disk_submit_read (int block, void *buffer) {
+    return disk_submit_async(DISK_READ, block, buffer);
+}
+
+disk_request_t *disk_submit_write (int block, void *buffer) {
+    return disk_submit_async(DISK_WRITE, block, buffer);
+}
+
+int disk_wait (disk_request_t *request) {
+    if (!(request))
+        return -1;
+
+    return disk_wait_request(request);
+}
+
+int disk_wait_all (disk_request_t **requests, int n) {
+    int result = 0;
+
+    if (!(requests) || n < 0)
+        return -1;
+
+    // os pedidos já estão todos no disco: esperar em ordem custa o mais lento
+    for (int i = 0; i < n; i++)
+        if (disk_wait(requests[i]) < 0)
+            result = -1;
+
+    return result;
+}
+
+// ========================== Leituras com prazo ============================== 
+
+// disk_block_read_try só atende no cache. disk_block_read_timed não pode
+// deixar o disco escrever no buffer de quem pediu depois de desistir, então
+// lê num buffer do cache (como a leitura antecipada) ou, sem cache ou sem
+// buffer limpo livre, num buffer próprio, que o gerente libera se a tarefa
+// desistiu. As esperas são ppos_wait_timed até o prazo da leitura.
+
+// espera *addr sair de expected até deadline; chamada e retorna com
+// can_preempt = 0. Retorna PPOS_ETIMEDOUT se o prazo passou
+int disk_wait_until(int *addr, int expected, unsigned int deadline) {
+    int remaining = (int) (deadline - systime());
+
+    if (remaining <= 0)
+        return PPOS_ETIMEDOUT;
+    ppos_wait_timed(addr, expected, remaining);
+    can_preempt = 0;
+    return 0;
+}
+
+int disk_block_read_try (int block, void *buffer) {
+    if (!disk_valid_request(block, buffer))
+        return -1;
+    if (!(disk->cache))
+        return PPOS_EAGAIN;
+
+    can_preempt = 0;
+    disk_buffer_t *cached = disk_cache_lookup(block);
+    if (!cached || cached->busy) {
+        can_preempt = 1;
+        return PPOS_EAGAIN;
+    }
+
+    disk_cache_hit(cached);
+    bcopy(cached->data, buffer, disk->blocks_size);
+    can_preempt = 1;
+    return 0;
+}
+
+// conclusão de uma leitura abandonada no prazo
+void disk_bounce_done(disk_request_t *request) {
+    free(request->arg);
+    disk_request_free(request);
+}
+
+// leitura fora do cache num buffer próprio
+int disk_bounce_read(int block, void *buffer, unsigned int deadline) {
+    disk_request_t *request;
+
+    can_preempt = 0;
+    while (!(request = disk_request_alloc(0))) {
+        if (disk_wait_until(&disk->free_count, 0, deadline) < 0) {
+            can_preempt = 1;
+            return PPOS_ETIMEDOUT;
+        }
+    }
+    can_preempt = 1;
+
+    char *data = malloc(disk->blocks_size);
+    create_disk_request(request, DISK_READ, block, data);
+    request->task = NULL;
+    disk_submit(request);
+
+    can_preempt = 0;
+    while (!(request->completed)) {
+        if (disk_wait_until(&request->completed, 0, deadline) < 0) {
+            // o gerente entrega a conclusão a disk_bounce_done
+            request->callback = disk_bounce_done;
+            request->arg = data;
+            can_preempt = 1;
+            return PPOS_ETIMEDOUT;
+        }
+    }
+    can_preempt = 1;
+
+    int result = request->result;
+    if (result == 0)
+        bcopy(data, buffer, disk->blocks_size);
+    free(data);
+    disk_request_free(request);
+
+    return result;
+}
+
+int disk_block_read_timed (int block, void *buffer, int ms) {
+    if (ms <= 0)
+        return disk_block_read_try(block, buffer);
+    if (!disk_valid_request(block, buffer))
+        return -1;
+
+    unsigned int deadline = systime() + ms;
+    int filled = 0;
+
+    while (disk->cache) {
+        can_preempt = 0;
+        disk_buffer_t *cached = disk_cache_lookup(block);
+
+        if (cached && !(cached->busy)) {
+            disk_cache_hit(cached);
+            bcopy(cached->data, buffer, disk->blocks_size);
+            can_preempt = 1;
+            return 0;
+        }
+
+        if (!cached) {
+            // a leitura para o cache falhou: o buffer próprio traz o erro
+            if (filled)
+                break;
+
+            // só buffers limpos: gravar um sujo faria a tarefa esperar
+            disk_buffer_t *victim = disk_cache_victim();
+            disk_request_t *request = (victim && !(victim->dirty)) ? disk_request_alloc(0) : NULL;
+            if (!request)
+                break;
+
+            disk->stats.cache_misses += 1;
+            disk_cache_rehash(victim, block);
+            victim->busy = 1;
+            victim->referenced = 1;
+
+            create_disk_request(request, DISK_READ, block, victim->data);
+            request->task = NULL;
+            request->callback = disk_cache_fill_done;
+            request->arg = victim;
+            disk_submit(request);
+            filled = 1;
+            cached = victim;
+        }
+
+        // o bloco está em E/S: espera a conclusão ou o prazo
+        if (disk_wait_until(&cached->busy, 1, deadline) < 0) {
+            can_preempt = 1;
+            return PPOS_ETIMEDOUT;
+        }
+    }
+    can_preempt = 1;
+
+    return disk_bounce_read(block, buffer, deadline);
+}
+
+// ========================== Anéis de disco ============================== 
+
+// Cada anel é um par de filas SPSC como as de MQUEUE_SPSC: a tarefa só
+// escreve sq_tail e cq_head, o gerente só escreve sq_head e cq_tail, então
+// preencher e publicar pedidos são algumas escritas na memória da tarefa,
+// sem disk_lock. A publicação conta os pedidos em disk->pending e liga
+// disk->signaled, e o dispatcher põe o gerente para rodar. O gerente retira
+// as entradas de todos os anéis com uma só trava do disco e os pedidos
+// voltam pela conclusão (disk_ring_done) para a fila cq do anel.
+//
+// Os disk_request_t vêm de ring->requests, que só o gerente toca. Uma tarefa
+// não tem mais de DISK_RING_SIZE pedidos não colhidos, então os pedidos
+// livres e as vagas de cq nunca faltam.
+//
+// Com o cache ligado, escritas do anel ficam no cache como as de
+// disk_submit_write. O gerente não pode esperar a gravação de um buffer sujo:
+// ele a inicia (disk_cache_clean) e a entrada fica no anel até a liberação do
+// buffer.
+
+// publica a conclusão no anel e devolve o pedido à lista de livres
+void disk_ring_complete(disk_ring_t *ring, disk_request_t *request) {
+    disk_cqe_t *cqe = &ring->cq[ring->cq_tail % DISK_RING_SIZE];
+
+    cqe->user_data = request->user_data;
+    cqe->result = request->result;
+
+    request->next = ring->free;
+    ring->free = request;
+    spsc_publish(&ring->cq_tail, 1, &ring->cq_waiting);
+}
+
+void disk_ring_done(disk_request_t *request) {
+    disk_ring_complete(request->arg, request);
+}
+
+// conclusão da gravação iniciada por disk_cache_clean
+void disk_cache_clean_done(disk_request_t *request) {
+    disk_buffer_t *buffer = request->arg;
+
+    if (request->result == 0) {
+        buffer->dirty = 0;
+        disk->cache_dirty -= 1;
+        disk->stats.cache_writebacks += 1;
+    }
+    disk_cache_release(buffer);
+
+    disk_request_free(request);
+}
+
+// começa a gravar um buffer sujo sem esperar; sem pedido livre, desiste
+void disk_cache_clean(disk_buffer_t *buffer) {
+    disk_request_t *request = disk_request_alloc(0);
+    if (!request)
+        return;
+
+    buffer->busy = 1;
+    create_disk_request(request, DISK_WRITE, buffer->block, buffer->data);
+    request->task = NULL;
+    request->callback = disk_cache_clean_done;
+    request->arg = buffer;
+    disk_submit(request);
+}
+
+// guarda no cache a escrita de um bloco que não está nele, num buffer limpo;
+// retorna 0 se não havia buffer limpo livre (a entrada espera no anel)
+int disk_cache_absorb(int block, void *data) {
+    disk_buffer_t *victim = disk_cache_victim();
+
+    if (!victim)
+        return 0;
+    if (victim->dirty) {
+        disk_cache_clean(victim);
+        return 0;
+    }
+
+    disk->stats.cache_misses += 1;
+    disk_cache_rehash(victim, block);
+    victim->referenced = 1;
+    disk_cache_store(victim, data);
+    return 1;
+}
+
+// retira as entradas publicadas de um anel; chamada pelo gerente com o disco
+// travado. Um bloco do cache em E/S, ou uma escrita sem buffer limpo, fica
+// no anel até a próxima passada, depois de o disco liberar um buffer
+void disk_ring_drain(disk_ring_t *ring) {
+    unsigned int tail = __atomic_load_n(&ring->sq_tail, __ATOMIC_ACQUIRE);
+
+    while (ring->sq_head != tail) {
+        disk_sqe_t *sqe = &ring->sq[ring->sq_head % DISK_RING_SIZE];
+        disk_buffer_t *cached = NULL;
+        int absorbed = 0;
+
+        if (disk->cache && (cached = disk_cache_lookup(sqe->block)) && cached->busy)
+            break;
+
+        if (disk->cache && !cached && sqe->type == DISK_WRITE && disk_valid_request(sqe->block, sqe->buffer)) {
+            if (!disk_cache_absorb(sqe->block, sqe->buffer))
+                break;
+            absorbed = 1;
+        }
+
+        disk_request_t *request = ring->free;
+        ring->free = request->next;
+
+        create_disk_request(request, sqe->type, sqe->block, sqe->buffer);
+        request->task = NULL;
+        request->callback = disk_ring_done;
+        request->arg = ring;
+        request->user_data = sqe->user_data;
+        __atomic_store_n(&ring->sq_head, ring->sq_head + 1, __ATOMIC_RELEASE);
+
+        if (!disk_valid_request(sqe->block, sqe->buffer) || cached || absorbed) {
+            if (cached)
+                disk_cache_copy(cached, request);
+            else if (!absorbed)
+                request->result = -1;
+            disk->pending -= 1;
+            disk_ring_complete(ring, request);
+            continue;
+        }
+
+        queue_append((queue_t**) &disk->requests[request->type], (queue_t*) request);
+    }
+}
+
+// retira as entradas de todos os anéis e enche a fila de comandos do disco
+void disk_rings_drain() {
+    sigset_t old;
+
+    if (!(disk->rings))
+        return;
+
+    int old_can_preempt = disk_lock(&old);
+    disk_ring_t *ring = disk->rings;
+    do {
+        disk_ring_drain(ring);
+        ring = ring->next;
+    } while (ring != disk->rings);
+    disk_start_next();
+    disk_unlock(&old, old_can_preempt);
+}
+
+int disk_ring_init (disk_ring_t *ring) {
+    sigset_t old;
+
+    if (!(ring))
+        return -1;
+
+    memset(ring, 0, sizeof(disk_ring_t));
+    for (int i = 0; i < DISK_RING_SIZE; i++) {
+        ring->requests[i].next = ring->free;
+        ring->free = &ring->requests[i];
+    }
+
+    int old_can_preempt = disk_lock(&old);
+    queue_append((queue_t**) &disk->rings, (queue_t*) ring);
+    disk_unlock(&old, old_can_preempt);
+
+    return 0;
+}
+
+int disk_ring_destroy (disk_ring_t *ring) {
+    sigset_t old;
+    disk_cqe_t cqe;
+
+    if (!(ring))
+        return -1;
+
+    ring->sq_prepared = ring->sq_tail;
+    while (ring->cq_head != ring->sq_tail)
+        disk_ring_reap(ring, &cqe, 1, 1);
+
+    int old_can_preempt = disk_lock(&old);
+    queue_remove((queue_t**) &disk->rings, (queue_t*) ring);
+    disk_unlock(&old, old_can_preempt);
+
+    return 0;
+}
+
+int disk_ring_prep (disk_ring_t *ring, int type, int block, void *buffer, void *user_data) {
+    if (!(ring) || (type != DISK_READ && type != DISK_WRITE))
+        return -1;
+
+    // pedidos preenchidos e ainda não colhidos ocupam uma vaga cada
+    if (ring->sq_prepared - __atomic_load_n(&ring->cq_head, __ATOMIC_ACQUIRE) >= DISK_RING_SIZE)
+        return -1;
+
+    disk_sqe_t *sqe = &ring->sq[ring->sq_prepared % DISK_RING_SIZE];
+    sqe->type = type;
+    sqe->block = block;
+    sqe->buffer = buffer;
+    sqe->user_data = user_data;
+    ring->sq_prepared += 1;
+
+    return 0;
+}
+
+int disk_ring_submit (disk_ring_t *ring) {
+    if (!(ring))
+        return -1;
+
+    int count = ring->sq_prepared - ring->sq_tail;
+    if (count == 0)
+        return 0;
+
+    // a tarefa pode ser preemptada aqui: pending é somado atomicamente
+    __atomic_add_fetch(&disk->pending, count, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&ring->sq_tail, ring->sq_prepared, __ATOMIC_RELEASE);
+    disk->signaled = 1;
+
+    return count;
+}
+
+int disk_ring_reap (disk_ring_t *ring, disk_cqe_t *cqes, int max, int min) {
+    int count = 0;
+
+    if (!(ring) || !(cqes) || max < 0)
+        return -1;
+
+    // sem pedidos publicados suficientes, a espera não terminaria
+    if (min > (int) (ring->sq_tail - ring->cq_head))
+        min = ring->sq_tail - ring->cq_head;
+
+    while (count < max) {
+        unsigned int tail = __atomic_load_n(&ring->cq_tail, __ATOMIC_ACQUIRE);
+
+        if (ring->cq_head == tail) {
+            if (count >= min)
+                break;
+
+            // o sinalizador é publicado antes de reler o índice (em
+            // ppos_wait), e o gerente publica o índice antes de lê-lo
+            __atomic_store_n(&ring->cq_waiting, 1, __ATOMIC_SEQ_CST);
+            ppos_wait((int *) &ring->cq_tail, (int) tail);
+            __atomic_store_n(&ring->cq_waiting, 0, __ATOMIC_SEQ_CST);
+            continue;
+        }
+
+        cqes[count++] = ring->cq[ring->cq_head % DISK_RING_SIZE];
+        __atomic_store_n(&ring->cq_head, ring->cq_head + 1, __ATOMIC_RELEASE);
+    }
+
+    return count;
+}
+
+int disk_set_queue_depth (int depth) {
+    sigset_t old;
+
+    if (depth < 1 || depth > disk_cmd(DISK_CMD_QDEPTH, 0, 0)) {
+        #ifdef DEBUG
+            perror("[ERRO] Profundidade de fila inválida!\n");
+        #endif
+        return -1;
+    }
+
+    int old_can_preempt = disk_lock(&old);
+    disk->depth = depth;
+    disk_start_next();
+    disk_unlock(&old, old_can_preempt);
+
+    return 0;
+}
+
+int disk_set_readahead (int max_blocks) {
+    if (max_blocks < 0)
+        return -1;
+
+    disk->ra_max = max_blocks;
+    return 0;
+}
+
+int disk_cache_config (int nbuffers) {
+    if (nbuffers < 0 || disk->blocks_size <= 0) {
+        #ifdef DEBUG
+            perror("[ERRO] Tamanho de cache inválido ou disco não inicializado!\n");
+        #endif
+        return -1;
+    }
+
+    if (disk_sync() < 0)
+        return -1;
+
+    if (disk->cache) {
+        for (int i = 0; i < disk->cache_size; i++)
+            free(disk->cache[i].data);
+        free(disk->cache);
+        free(disk->cache_hash);
+        disk->cache = NULL;
+        disk->cache_hash = NULL;
+        disk->cache_size = 0;
+    }
+
+    if (nbuffers == 0)
+        return 0;
+
+    int hash_size = 1;
+    while (hash_size < nbuffers)
+        hash_size <<= 1;
+
+    disk->cache = calloc(nbuffers, sizeof(disk_buffer_t));
+    disk->cache_hash = calloc(hash_size, sizeof(disk_buffer_t *));
+    for (int i = 0; i < nbuffers; i++) {
+        disk->cache[i].block = -1;
+        disk->cache[i].data = malloc(disk->blocks_size);
+    }
+    disk->cache_size = nbuffers;
+    disk->cache_hash_mask = hash_size - 1;
+    disk->cache_hand = 0;
+    disk->cache_dirty = 0;
+
+    return 0;
+}
 
 void disk_mgr_body (void * args)
 {
+   sigset_t old;
+
    while (1) 
    {
-      // obtém o semáforo de acesso ao disco
-      sem_down(disk->disk_semaphore);
- 
-      // se foi acordado devido a um sinal do disco
-      if ( 0 /* disco gerou um sinal */)
-      {
-         // acorda a tarefa cujo pedido foi atendido
-      }
- 
-      // se o disco estiver livre e houver pedidos de E/S na fila
-      if ( 0/*  disco_livre && (fila_disco != NULL) */)
-      {
-         // escolhe na fila o pedido a ser atendido, usando FCFS
-         // solicita ao disco a operação de E/S, usando disk_cmd()
-      }
- 
-      // libera o semáforo de acesso ao disco
-      sem_up(disk->disk_semaphore);
- 
-      // suspende a tarefa corrente (retorna ao dispatcher)
+      // retira os pedidos concluídos sem concorrer com o tratador
+      int old_can_preempt = disk_lock(&old);
+      disk_request_t *done = disk->done;
+      disk->done = NULL;
+      disk->signaled = 0;
+      disk_unlock(&old, old_can_preempt);
+
+      // pedidos publicados nos anéis das tarefas
+      disk_rings_drain();
 
-      // suspender_tarefa
-      suspend_disk_task();
+      // acorda as tarefas cujos pedidos foram atendidos
+      while (done) {
+         disk_request_t *request = done;
+         queue_remove((queue_t**) &done, (queue_t*) request);
 
-      task_yield();
+         disk->pending -= 1;
+         request->completed = 1;
+         if (request->callback)
+            request->callback(request);
+         else
+            ppos_wake(&request->completed, -1);
+      }
+
+      // sem entregas pendentes, dorme até o próximo sinal do disco
+      can_preempt = 0;
+      if (!(disk->done) && !(disk->signaled))
+         suspend_disk_task();
+      can_preempt = 1;
    }
-}
\ No newline at end of file
+}
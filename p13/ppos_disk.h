@@ -11,29 +11,152 @@
 // a um dispositivo de entrada/saida orientado a blocos,
 // tipicamente um disco rigido.
 
-// estrutura que representa um disco no sistema operacional
-typedef struct
-{
-  semaphore_t *disk_semaphore;
-  task_t **disk_suspended_tasks;
-  int disk_suspended_tasks_count;
-  int blocks_size;
-  int num_blocks;
-  // completar com os campos necessarios
-} disk_t ;
+#include "hard_disk.h"
 
-enum disk_request_type {read = 1, write = 0}; 
+enum disk_request_type {DISK_READ = 1, DISK_WRITE = 0}; 
 
-typedef struct
+// políticas de escalonamento dos pedidos (disk_set_scheduler)
+#define DISK_FCFS  0    // ordem de chegada
+#define DISK_SSTF  1    // menor distância da cabeça
+#define DISK_CSCAN 2    // varredura circular em ordem crescente de bloco
+#define DISK_DEADLINE 3 // C-SCAN por direção, com prazo por pedido
+
+// vezes que o pedido mais antigo pode ser preterido antes de ser atendido
+#define DISK_MAX_SKIPS 32
+
+// prazos (ms) e tamanho do lote de mesma direção da política DISK_DEADLINE
+#define DISK_READ_EXPIRE 500
+#define DISK_WRITE_EXPIRE 5000
+#define DISK_DEADLINE_BATCH 16
+
+// pedidos pré-alocados do gerente (os anéis têm os seus)
+#define DISK_NR_REQUESTS 128
+
+// entradas de cada anel de submissão e de conclusão (disk_ring_init)
+#define DISK_RING_SIZE 32
+
+// janela de leitura antecipada: inicial e máxima (disk_set_readahead), em blocos
+#define DISK_RA_MIN 2
+#define DISK_RA_MAX 16
+
+typedef struct disk_request_t
 {
     struct disk_request_t *prev, *next ;		// ponteiros para usar em filas
     task_t *task;
     enum disk_request_type type ;
     int block;
     void *buffer;
-    // completar com os campos necessarios
+    int result;                 // 0 ok, -1 erro do disco
+    int completed;              // resultado já entregue (ppos_wait espera aqui)
+    int skipped;                // vezes preterido sendo o mais antigo
+    unsigned int arrival;       // instante do pedido (ms)
+    unsigned int deadline;      // prazo do pedido na política DISK_DEADLINE
+    void (*callback)(struct disk_request_t *); // conclusão sem tarefa esperando
+    void *arg;                  // dado do callback
+    void *user_data;            // devolvido na conclusão de um anel
 } disk_request_t ;
 
+// entrada de submissão de um anel: um pedido preenchido pela tarefa
+typedef struct
+{
+    int type;                   // DISK_READ ou DISK_WRITE
+    int block;
+    void *buffer;
+    void *user_data;            // devolvido na conclusão
+} disk_sqe_t ;
+
+// entrada de conclusão de um anel
+typedef struct
+{
+    void *user_data;
+    int result;                 // 0 ok, -1 erro
+} disk_cqe_t ;
+
+// anéis de submissão (sq) e conclusão (cq) de uma tarefa; cada índice só é
+// escrito por um lado: sq_tail e cq_head pela tarefa, sq_head e cq_tail pelo
+// gerente. Os índices crescem sem limite (a entrada é índice % DISK_RING_SIZE)
+typedef struct disk_ring_t
+{
+    struct disk_ring_t *prev, *next;    // anéis registrados no gerente
+    disk_sqe_t sq[DISK_RING_SIZE];
+    disk_cqe_t cq[DISK_RING_SIZE];
+    unsigned int sq_prepared;   // entradas preenchidas (disk_ring_prep)
+    unsigned int sq_tail;       // ... publicadas (disk_ring_submit)
+    unsigned int sq_head;       // ... já retiradas pelo gerente
+    unsigned int cq_tail;       // conclusões publicadas pelo gerente
+    unsigned int cq_head;       // ... já colhidas pela tarefa
+    int cq_waiting;             // tarefa dormindo em cq_tail
+    disk_request_t requests[DISK_RING_SIZE]; // pedidos do anel, só do gerente
+    disk_request_t *free;       // pedidos livres, encadeados por next
+} disk_ring_t ;
+
+// buffer do cache de blocos (disk_cache_config)
+typedef struct disk_buffer_t
+{
+    struct disk_buffer_t *hash_next;    // encadeamento na tabela hash
+    int block;                  // bloco guardado, -1 se livre
+    int dirty;                  // alterado e ainda não gravado no disco
+    int busy;                   // em E/S; outras tarefas esperam (ppos_wait)
+    int referenced;             // bit de referência do relógio (CLOCK)
+    int readahead;              // lido antecipadamente e ainda não usado
+    char *data;
+} disk_buffer_t ;
+
+// estatísticas do disco desde disk_mgr_init ou disk_set_scheduler
+typedef struct
+{
+  unsigned long served;         // pedidos concluídos
+  unsigned long head_travel;    // soma das distâncias de busca, em blocos
+  unsigned long latency_total;  // soma de pedido -> conclusão, em ms
+  unsigned int latency_max;
+  unsigned long type_served[2]; // por direção, indexados por DISK_READ/DISK_WRITE
+  unsigned long type_latency[2];
+  unsigned int type_latency_max[2];
+  unsigned long expired;        // pedidos atendidos fora de ordem por prazo
+  unsigned long commands;       // comandos enviados ao disco
+  unsigned long merged;         // pedidos que foram juntos com outro no comando
+  unsigned long cache_hits;     // acessos atendidos pelo cache
+  unsigned long cache_misses;
+  unsigned long cache_writebacks; // blocos sujos gravados no disco
+  int cache_dirty;              // blocos sujos no cache agora
+  unsigned long readahead_issued; // blocos pedidos por leitura antecipada
+  unsigned long readahead_hits;   // ... usados depois por alguma leitura
+  unsigned long readahead_wasted; // ... substituídos sem uso
+} disk_stats_t ;
+
+// estrutura que representa um disco no sistema operacional
+typedef struct
+{
+  disk_request_t *requests[2];  // pedidos esperando, por direção, em ordem de chegada
+  disk_request_t *inflight[DISK_QUEUE_DEPTH]; // pedidos de cada comando no disco, por tag
+  int inflight_count;           // comandos no disco
+  int depth;                    // máximo de comandos no disco (disk_set_queue_depth)
+  disk_iovec_t iov;             // buffers do comando sendo enviado
+  disk_request_t *done;         // pedidos concluídos, a entregar pelo gerente
+  volatile int signaled;        // SIGUSR1 recebido desde a última entrega
+  int policy;                   // DISK_FCFS, DISK_SSTF, DISK_CSCAN ou DISK_DEADLINE
+  int batch_type;               // direção do lote corrente (DISK_DEADLINE)
+  int batch_left;               // pedidos que ainda cabem no lote
+  int head;                     // último bloco do último comando enviado ao disco
+  int device_head;              // último bloco do último comando concluído
+  disk_stats_t stats;
+  disk_buffer_t *cache;         // buffers do cache de blocos (NULL: sem cache)
+  disk_buffer_t **cache_hash;   // tabela hash de block para buffer
+  int cache_size;
+  int cache_hash_mask;          // tamanho da tabela - 1 (potência de 2)
+  int cache_hand;               // ponteiro do relógio
+  int cache_dirty;
+  int cache_released;           // muda quando um buffer deixa de estar em E/S
+  int ra_max;                   // janela máxima de leitura antecipada
+  int pending;                  // pedidos na fila ou no disco, ainda não entregues
+  disk_ring_t *rings;           // anéis registrados (disk_ring_init)
+  disk_request_t request_pool[DISK_NR_REQUESTS];
+  disk_request_t *free_requests; // pedidos livres do conjunto, encadeados por next
+  int free_count;
+  int blocks_size;
+  int num_blocks;
+} disk_t ;
+
 // inicializacao do gerente de disco
 // retorna -1 em erro ou 0 em sucesso
 // numBlocks: tamanho do disco, em blocos
@@ -43,10 +166,85 @@ int disk_mgr_init (int *numBlocks, int *blockSize) ;
 // leitura de um bloco, do disco para o buffer
 int disk_block_read (int block, void *buffer) ;
 
+// leitura só se não bloquear: atende blocos do cache, senão PPOS_EAGAIN
+int disk_block_read_try (int block, void *buffer) ;
+
+// leitura esperando no máximo ms milissegundos; PPOS_ETIMEDOUT no prazo
+// (o buffer não é alterado depois disso)
+int disk_block_read_timed (int block, void *buffer, int ms) ;
+
 // escrita de um bloco, do buffer para o disco
 int disk_block_write (int block, void *buffer) ;
 
+// escolhe a política de escalonamento (padrão DISK_SSTF) e zera as
+// estatísticas; retorna -1 em erro ou 0 em sucesso
+int disk_set_scheduler (int policy) ;
+
+// copia as estatísticas do disco; retorna -1 em erro ou 0 em sucesso
+int disk_stats (disk_stats_t *stats) ;
+
+// imprime percurso da cabeça e latência média dos pedidos
+void disk_print_stats () ;
+
+// cria um cache de nbuffers blocos na frente do disco (0 desliga); o cache
+// existente é gravado e descartado. Escritas ficam no cache até o bloco ser
+// substituído ou até disk_sync. Retorna -1 em erro ou 0 em sucesso
+int disk_cache_config (int nbuffers) ;
+
+// limita os comandos enviados ao mesmo tempo ao disco (1 a DISK_QUEUE_DEPTH,
+// padrão 1: pedidos que esperam no gerente ainda podem ser escalonados e
+// juntados); retorna -1 em erro ou 0 em sucesso
+int disk_set_queue_depth (int depth) ;
+
+// limita a janela de leitura antecipada do cache a max_blocks (0 desliga);
+// retorna -1 em erro ou 0 em sucesso
+int disk_set_readahead (int max_blocks) ;
+
+// grava no disco os blocos sujos do cache; retorna -1 em erro ou 0
+int disk_sync () ;
+
+// E/S assíncrona: põe o pedido na fila do disco e retorna sem esperar; o
+// buffer só pode ser usado (leitura) ou alterado (escrita) depois de
+// disk_wait. Com o cache ligado, escritas ficam no cache (como em
+// disk_block_write), leituras de blocos em cache são atendidas nele e as
+// demais vão direto ao disco. Retorna o pedido, ou NULL em erro ou se os
+// DISK_NR_REQUESTS pedidos estão em uso
+disk_request_t *disk_submit_read (int block, void *buffer) ;
+disk_request_t *disk_submit_write (int block, void *buffer) ;
+
+// espera o pedido ser atendido e o libera; retorna -1 em erro ou 0
+int disk_wait (disk_request_t *request) ;
+
+// espera os n pedidos; retorna -1 se algum falhou ou 0
+int disk_wait_all (disk_request_t **requests, int n) ;
+
+// anéis de submissão e conclusão: a tarefa preenche entradas e as publica
+// sem travar o disco; o gerente as retira em lote e devolve as conclusões
+// no anel. Como em disk_submit_read/write, com o cache ligado as escritas
+// ficam nele e as leituras de blocos em cache são atendidas nele. Retornam
+// -1 em erro ou 0, exceto onde indicado
+
+// registra um anel vazio no gerente
+int disk_ring_init (disk_ring_t *ring) ;
+
+// espera os pedidos publicados, descarta os não publicados e desregistra
+int disk_ring_destroy (disk_ring_t *ring) ;
+
+// preenche uma entrada de submissão; -1 se o anel está cheio (DISK_RING_SIZE
+// pedidos ainda não colhidos). O buffer fica com o disco até a conclusão
+int disk_ring_prep (disk_ring_t *ring, int type, int block, void *buffer, void *user_data) ;
+
+// publica as entradas preenchidas e retorna quantas foram
+int disk_ring_submit (disk_ring_t *ring) ;
+
+// copia até max conclusões para cqes, esperando até haver pelo menos min
+// (limitado aos pedidos publicados); retorna quantas copiou
+int disk_ring_reap (disk_ring_t *ring, disk_cqe_t *cqes, int max, int min) ;
+
 // corpo do gestor do disco
 void disk_mgr_body (void * args) ;
 
+// tratador do SIGUSR1 gerado pelo disco ao concluir uma operação
+void disk_signal_handler (int signum) ;
+
 #endif